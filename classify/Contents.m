@@ -37,10 +37,12 @@
 %   fernsRegApply      - Apply learned fern regressor.
 %   fernsRegTrain      - Train boosted fern regressor.
 %   forestApply        - Apply learned forest classifier.
+%   forestPack         - Pack learned forest classifier into a compact contiguous format.
 %   forestTrain        - Train random forest classifier.
 %
 % Fast boosted decision tree code:
 %   adaBoostTrain      - Train boosted decision tree classifier.
 %   adaBoostApply      - Apply learned boosted decision tree classifier.
+%   adaBoostCascade    - Calibrate soft cascade of boosted decision tree classifier.
 %   binaryTreeTrain    - Train binary decision tree classifier.
 %   binaryTreeApply    - Apply learned binary decision tree classifier.
@@ -1,8 +1,20 @@
-function hs = adaBoostApply( X, model, maxDepth, minWeight, nThreads )
+function [hs,trees] = adaBoostApply( X, model, maxDepth, minWeight, ...
+  nThreads, thr )
 % Apply learned boosted decision tree classifier.
 %
+% All trees are applied by a compiled routine that processes the samples in
+% small blocks (distributed over nThreads threads), applying every tree to
+% a block before moving on to the next block. If a rejection threshold thr
+% is specified the model is applied as a soft cascade (as in acfDetect):
+% once the cumulative score of a sample drops to or below thr the sample is
+% retired and the remaining trees are not evaluated for it (its output is
+% the partial score at the time of rejection). This is much faster if most
+% samples are negatives, e.g. when mining hard negatives, and is best used
+% with a model calibrated by adaBoostCascade.
+%
 % USAGE
-%  hs = adaBoostApply( X, model, [maxDepth], [minWeight], [nThreads] )
+%  [hs,trees] = adaBoostApply( X, model, [maxDepth], [minWeight], ...
+%    [nThreads], [thr] )
 %
 % INPUTS
 %  X          - [NxF] N length F feature vectors
@@ -10,13 +22,15 @@ function hs = adaBoostApply( X, model, maxDepth, minWeight, nThreads )
 %  maxDepth   - [] maximum depth of tree
 %  minWeight  - [] minimum sample weigth to allow split
 %  nThreads   - [16] max number of computational threads to use
+%  thr        - [-inf] rejection threshold of soft cascade
 %
 % OUTPUTS
-%  hs         - [Nx1] predicted output log ratios
+%  hs         - [Nx1] predicted output log ratios (single)
+%  trees      - [Nx1] number of trees evaluated for each sample
 %
 % EXAMPLE
 %
-% See also adaBoostTrain
+% See also adaBoostTrain, adaBoostCascade
 %
 % Piotr's Computer Vision Matlab Toolbox      Version 3.40
 % Copyright 2014 Piotr Dollar.  [pdollar-at-gmail.com]
@@ -25,12 +39,10 @@ function hs = adaBoostApply( X, model, maxDepth, minWeight, nThreads )
 if(nargin<3 || isempty(maxDepth)), maxDepth=0; end
 if(nargin<4 || isempty(minWeight)), minWeight=0; end
 if(nargin<5 || isempty(nThreads)), nThreads=16; end
+if(nargin<6 || isempty(thr)), thr=-inf; end
 if(maxDepth>0), model.child(model.depth>=maxDepth) = 0; end
 if(minWeight>0), model.child(model.weights<=minWeight) = 0; end
-nWeak=size(model.fids,2); N=size(X,1); hs=zeros(N,1); nt=nThreads;
-for i=1:nWeak
-  ids = forestInds(X,model.thrs(:,i),model.fids(:,i),model.child(:,i),nt);
-  hs = hs + model.hs(ids,i);
-end
+[hs,trees] = adaBoostApply1(X,model.thrs,model.fids,model.child,...
+  model.hs,thr,nThreads);
 
 end
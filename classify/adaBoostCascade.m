@@ -0,0 +1,130 @@
+function [model,info] = adaBoostCascade( model, X0, X1, varargin )
+% Calibrate soft cascade of boosted decision tree classifier.
+%
+% Boosted classifiers trained by adaBoostTrain are typically applied as a
+% constant soft cascade (see acfDetect.m): the trees are evaluated in order
+% and evaluation stops as soon as the cumulative score drops to or below a
+% rejection threshold thr. The runtime is therefore largely determined by
+% how quickly negatives are rejected (see the stats output of acfDetect.m
+% to measure the average number of trees evaluated per window). Given a
+% trained model and a set of negative and positive samples, this function
+% optimizes the cascade to reduce the expected number of trees evaluated:
+%  (1) If order=1 the trees are greedily reordered: at each step, of the
+%   next 'window' remaining trees, the one that rejects the most remaining
+%   negatives is evaluated next (the final score is unaffected).
+%  (2) A rejection threshold r(t) is derived for each tree t using direct
+%   backward pruning [Zhang & Viola, NIPS07]: r(t) is set just below the
+%   lowest partial score of any positive accepted by the original cascade
+%   (optionally allowing a fraction 'fracPos' of the remaining positives to
+%   be rejected at each tree). The last threshold is always r(end)=thr.
+% The per-tree thresholds are folded into the leaf values of each tree
+% (hs), so the model can still be applied with the constant threshold thr
+% (such as done by acfDetect) while the final score of any sample that is
+% not rejected early remains unchanged. Since the thresholds are stored as
+% offsets from thr, the calibrated model must be applied with the same thr
+% (stored in model.cascThr). Applying it with a different threshold shifts
+% every r(t) by the difference, so recalibrate instead (for a detector,
+% cascThr should not be changed via acfModify after calibration).
+%
+% Note that the samples used for calibration should be representative of
+% the data seen at test time (for example the negatives used in the last
+% round of bootstrapping in acfTrain). If the positives are the training
+% positives the thresholds may be overly aggressive, in which case a
+% 'margin' can be specified (each r(t) is reduced by the given amount).
+%
+% USAGE
+%  [model,info] = adaBoostCascade( model, X0, X1, [pCasc] )
+%
+% INPUTS
+%  model      - boosted tree classifier trained by adaBoostTrain
+%  X0         - [N0xF] negative feature vectors
+%  X1         - [N1xF] positive feature vectors
+%  pCasc      - additional params (struct or name/value pairs)
+%   .thr        - [-1] constant rejection threshold used by the cascade
+%   .order      - [1] if true reorder trees to reject negatives earlier
+%   .window     - [32] number of candidate trees considered at each step
+%   .fracPos    - [0] fraction of positives allowed to be rejected per tree
+%   .margin     - [0] amount by which to reduce each rejection threshold
+%   .nThreads   - [16] max number of computational threads to use
+%
+% OUTPUTS
+%  model      - calibrated model (fields fids, thrs, child, hs, weights,
+%               depth and errs are reordered and hs is recalibrated), the
+%               threshold used is stored in model.cascThr
+%  info       - information about calibration w the following fields
+%   .order      - [1 x nWeak] order of trees w.r.t. the input model
+%   .rejThrs    - [1 x nWeak] rejection threshold at each tree
+%   .trees0     - average trees evaluated per negative before calibration
+%   .trees1     - average trees evaluated per negative after calibration
+%   .recall0    - fraction of positives accepted before calibration
+%   .recall1    - fraction of positives accepted after calibration
+%
+% EXAMPLE
+%  N=5000; F=5000; sep=.01; RandStream.getGlobalStream.reset();
+%  [xTrn,hTrn,xTst,hTst]=demoGenData(N,N,2,F/10,sep,.5,0);
+%  xTrn=repmat(single(xTrn),[1 10]); xTst=repmat(single(xTst),[1 10]);
+%  pBoost=struct('nWeak',256,'pTree',struct('maxDepth',2));
+%  model = adaBoostTrain( xTrn(hTrn==1,:), xTrn(hTrn==2,:), pBoost );
+%  [model1,info] = adaBoostCascade( model, ...
+%    xTst(hTst==1,:), xTst(hTst==2,:), 'thr',-1 ); disp(info)
+%
+% See also adaBoostTrain, adaBoostApply, acfDetect, acfTrain
+%
+% Piotr's Computer Vision Matlab Toolbox      Version 3.50
+% Copyright 2014 Piotr Dollar.  [pdollar-at-gmail.com]
+% Licensed under the Simplified BSD License [see external/bsd.txt]
+
+% get additional parameters
+dfs={ 'thr',-1, 'order',1, 'window',32, 'fracPos',0, 'margin',0, ...
+  'nThreads',16 };
+[thr,order,window,fracPos,margin,nThreads]=getPrmDflt(varargin,dfs,1);
+nWeak=size(model.fids,2); assert(size(X0,2)==size(X1,2));
+
+% compute output of every tree on every sample
+H0=treeOutputs(X0,model,nThreads); N0=size(H0,1);
+H1=treeOutputs(X1,model,nThreads); N1=size(H1,1);
+[trees0,keep0]=cascApply(H0,H1,ones(1,nWeak)*thr);
+
+% greedily order trees and set rejection thresholds
+ord=zeros(1,nWeak); rs=zeros(1,nWeak); left=1:nWeak;
+h0=zeros(N0,1); h1=zeros(N1,1); act0=true(N0,1); act1=keep0;
+for t=1:nWeak
+  if(order), cs=left(1:min(window,end)); else cs=left(1); end
+  G1=bsxfun(@plus,h1(act1),double(H1(act1,cs))); n1=size(G1,1);
+  if(n1==0), r=ones(1,length(cs))*thr; else G1=sort(G1,1);
+    r=G1(floor(fracPos*n1)+1,:)-margin-1e-4; end
+  G0=bsxfun(@plus,h0(act0),double(H0(act0,cs)));
+  [~,c]=max(sum(bsxfun(@le,G0,r),1)); r=r(c); c=cs(c);
+  if(t==nWeak), r=thr; end; ord(t)=c; rs(t)=r; left(left==c)=[];
+  h0=h0+double(H0(:,c)); act0=act0 & h0>r;
+  h1=h1+double(H1(:,c)); act1=act1 & h1>r;
+end
+[trees1,keep1]=cascApply(H0(:,ord),H1(:,ord),rs);
+
+% reorder trees and fold rejection thresholds into leaf values
+fs={'fids','thrs','child','hs','weights','depth'};
+for i=1:length(fs), model.(fs{i})=model.(fs{i})(:,ord); end
+if(isfield(model,'errs')), model.errs=model.errs(ord); end
+offsets=rs-thr; deltas=diff([0 offsets]);
+model.hs=bsxfun(@minus,model.hs,single(deltas)); model.cascThr=thr;
+info=struct('order',ord,'rejThrs',rs,'trees0',trees0,'trees1',trees1,...
+  'recall0',mean(keep0),'recall1',mean(keep1));
+
+end
+
+function H = treeOutputs( X, model, nThreads )
+% Compute [NxnWeak] output of every tree on every sample.
+N=size(X,1); nWeak=size(model.fids,2); H=zeros(N,nWeak,'single');
+for t=1:nWeak
+  ids=forestInds(X,model.thrs(:,t),model.fids(:,t),model.child(:,t),nThreads);
+  H(:,t)=model.hs(ids,t);
+end
+end
+
+function [trees,keep1] = cascApply( H0, H1, rs )
+% Average trees evaluated per negative and positives kept by cascade.
+nWeak=length(rs); if(isempty(H0)), trees=0; else
+  R=bsxfun(@le,cumsum(double(H0),2),rs); [rej,t]=max(R,[],2);
+  t(~rej)=nWeak; trees=mean(t); end
+keep1=~any(bsxfun(@le,cumsum(double(H1),2),rs),2);
+end
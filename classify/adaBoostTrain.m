@@ -15,6 +15,17 @@ function model = adaBoostTrain( X0, X1, varargin )
 % Further gains using the ideas from the ICML paper are possible. If you
 % use this code please consider citing our ICML paper.
 %
+% If histCache>0, per class weighted histograms of the quantized features
+% are carried across rounds (see binaryTreeTrain.m). After each round the
+% weights of all samples at a given leaf are scaled by the same factor, so
+% the root histograms for the next tree are a weighted sum of the current
+% tree's leaf histograms and require no pass over the data (within a tree
+% only the smaller child of each split requires a pass over its samples,
+% see binaryTreeTrain.m). To bound accumulated numerical error (and the
+% effect of rare samples near a threshold that binaryTreeApply routes
+% differently than the quantized data), the histograms are recomputed from
+% scratch every histCache rounds. Caching uses O(nBins*F*nLeaves) memory.
+%
 % USAGE
 %  model = adaBoostTrain( X0, X1, [pBoost] )
 %
@@ -26,6 +37,7 @@ function model = adaBoostTrain( X0, X1, varargin )
 %   .nWeak      - [128] number of trees to learn
 %   .discrete   - [1] train Discrete-AdaBoost or Real-AdaBoost
 %   .verbose    - [0] if true print status information
+%   .histCache  - [0] if >0 cache histograms (recompute every histCache)
 %
 % OUTPUTS
 %  model      - learned boosted tree classifier w the following fields
@@ -57,8 +69,9 @@ function model = adaBoostTrain( X0, X1, varargin )
 % Licensed under the Simplified BSD License [see external/bsd.txt]
 
 % get additional parameters
-dfs={ 'pTree','REQ', 'nWeak',128, 'discrete',1, 'verbose',0 };
-[pTree,nWeak,discrete,verbose]=getPrmDflt(varargin,dfs,1);
+dfs={ 'pTree','REQ', 'nWeak',128, 'discrete',1, 'verbose',0, ...
+  'histCache',0 };
+[pTree,nWeak,discrete,verbose,histCache]=getPrmDflt(varargin,dfs,1);
 nThreads=[]; if(isfield(pTree,'nThreads')), nThreads=pTree.nThreads; end
 
 % main loop
@@ -70,7 +83,9 @@ H0=zeros(N0,1); H1=zeros(N1,1);
 losses=zeros(1,nWeak); errs=losses;
 for i=1:nWeak
   % train tree and classify each example
-  [tree,data,err]=binaryTreeTrain(data,pTree);
+  if(histCache && mod(i-1,histCache)==0), data.hist0=[]; data.hist1=[]; end
+  if(histCache), [tree,data,err,hists]=binaryTreeTrain(data,pTree);
+  else [tree,data,err]=binaryTreeTrain(data,pTree); end
   if(discrete), tree.hs=(tree.hs>0)*2-1; end
   h0 = binaryTreeApply(X0,tree,[],[],nThreads);
   h1 = binaryTreeApply(X1,tree,[],[],nThreads);
@@ -82,6 +97,7 @@ for i=1:nWeak
   H0=H0+h0*alpha; data.wts0=exp( H0)/N0/2;
   H1=H1+h1*alpha; data.wts1=exp(-H1)/N1/2;
   loss=sum(data.wts0)+sum(data.wts1);
+  if(histCache), [data.hist0,data.hist1]=updateHists(hists,tree.hs,data); end
   if(i==1), trees=repmat(tree,nWeak,1); end
   trees(i)=tree; errs(i)=err; losses(i)=loss;
   msg=' i=%4i alpha=%.3f err=%.3f loss=%.2e\n';
@@ -109,3 +125,12 @@ if(verbose), fp=mean(H0>0); fn=mean(H1<0);
   fprintf(msg,(fp+fn)/2,fp,fn,etime(clock,start)); end
 
 end
+
+function [hist0,hist1] = updateHists( hists, hs, data )
+% Compute root histograms for next tree by reweighting leaf histograms.
+hs=double(hs(hists.leaves)); [nBins,F,L]=size(hists.hist0);
+hist0=reshape(reshape(hists.hist0,[],L)*exp(hs),nBins,F);
+hist1=reshape(reshape(hists.hist1,[],L)*exp(-hs),nBins,F);
+hist0=hist0*(sum(data.wts0)/sum(hist0(:,1)));
+hist1=hist1*(sum(data.wts1)/sum(hist1(:,1)));
+end
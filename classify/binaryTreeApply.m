@@ -1,6 +1,13 @@
 function hs = binaryTreeApply( X, tree, maxDepth, minWeight, nThreads )
 % Apply learned binary decision tree classifier.
 %
+% Shallow trees (depth at most 4, such as the depth 2 trees used by acfTrain)
+% are evaluated by a compiled routine specialized for each depth: shallower
+% leaves are padded so that the tree is complete and the tests of all nodes
+% are computed for 16 samples at a time using SSE comparisons (for uint8 and
+% single data), after which the leaf reached by each sample is determined
+% without branching. Deeper trees are traversed one sample at a time.
+%
 % USAGE
 %  hs = binaryTreeApply( X, tree, [maxDepth], [minWeight], [nThreads] )
 %
@@ -27,6 +34,6 @@ if(nargin<4 || isempty(minWeight)), minWeight=0; end
 if(nargin<5 || isempty(nThreads)), nThreads=16; end
 if(maxDepth>0), tree.child(tree.depth>=maxDepth) = 0; end
 if(minWeight>0), tree.child(tree.weights<=minWeight) = 0; end
-hs = tree.hs(forestInds(X,tree.thrs,tree.fids,tree.child,nThreads));
+hs = binaryTreeApply1(X,tree.thrs,tree.fids,tree.child,tree.hs,nThreads);
 
 end
@@ -22,8 +22,23 @@ function [tree,data,err] = binaryTreeTrain( data, varargin )
 % once if training multiple trees. Note that the second output of the
 % algorithm is the quantized data, this can be reused in future training.
 %
+% Optionally, split search can operate on per class weighted histograms of
+% the quantized features. This is enabled if useHist is set, if the
+% histograms of the root are given (hist0 and hist1, these must be
+% consistent with the weights) or if the histograms at the leaves are
+% requested (fourth output). When a node is split, only the histograms of
+% the child with fewer samples are computed from the data, the histograms
+% of its sibling are obtained by subtracting the child's histograms from
+% its parent's. Thus the cost of training the nodes at each depth is
+% O(F*N/2) at most (rather than O(F*N) per node). The histograms are kept
+% in double precision, so the splits found may differ slightly from those
+% of the default (single precision) search. Outputting the leaf histograms
+% allows a caller that updates weights per leaf (such as adaBoostTrain.m)
+% to obtain the root histograms for the next tree without touching the
+% data.
+%
 % USAGE
-%  [tree,data,err] = binaryTreeTrain( data, [pTree] )
+%  [tree,data,err,hists] = binaryTreeTrain( data, [pTree] )
 %
 % INPUTS
 %  data       - data for training tree
@@ -34,12 +49,15 @@ function [tree,data,err] = binaryTreeTrain( data, varargin )
 %   .xMin       - [1xF] optional vals defining feature quantization
 %   .xStep      - [1xF] optional vals defining feature quantization
 %   .xType      - [] optional original data type for features
+%   .hist0      - [] optional [nBinsxF] weighted histograms of X0 (root)
+%   .hist1      - [] optional [nBinsxF] weighted histograms of X1 (root)
 %  pTree      - additional params (struct or name/value pairs)
 %   .nBins      - [256] maximum number of quanizaton bins (<=256)
 %   .maxDepth   - [1] maximum depth of tree
 %   .minWeight  - [.01] minimum sample weigth to allow split
 %   .fracFtrs   - [1] fraction of features to sample for each node split
 %   .nThreads   - [16] max number of computational threads to use
+%   .useHist    - [0] if true use histogram split search (see above)
 %
 % OUTPUTS
 %  tree       - learned decision tree model struct w the following fields
@@ -51,6 +69,10 @@ function [tree,data,err] = binaryTreeTrain( data, varargin )
 %   .depth      - [Kx1] depth of each node
 %  data       - data used for training tree (quantized version of input)
 %  err        - decision tree training error
+%  hists      - weighted histograms at leaves (computing hists has a cost)
+%   .leaves     - [Lx1] ids of the L leaf nodes
+%   .hist0      - [nBinsxFxL] histograms of X0 at each leaf
+%   .hist1      - [nBinsxFxL] histograms of X1 at each leaf
 %
 % EXAMPLE
 %
@@ -61,19 +83,22 @@ function [tree,data,err] = binaryTreeTrain( data, varargin )
 % Licensed under the Simplified BSD License [see external/bsd.txt]
 
 % get parameters
-dfs={'nBins',256,'maxDepth',1,'minWeight',.01,'fracFtrs',1,'nThreads',16};
-[nBins,maxDepth,minWeight,fracFtrs,nThreads]=getPrmDflt(varargin,dfs,1);
+dfs={'nBins',256,'maxDepth',1,'minWeight',.01,'fracFtrs',1,'nThreads',16,...
+  'useHist',0};
+[nBins,maxDepth,minWeight,fracFtrs,nThreads,useHist]=...
+  getPrmDflt(varargin,dfs,1);
 assert(nBins<=256);
 
 % get data and normalize weights
 dfs={ 'X0','REQ', 'X1','REQ', 'wts0',[], 'wts1',[], ...
-  'xMin',[], 'xStep',[], 'xType',[] };
-[X0,X1,wts0,wts1,xMin,xStep,xType]=getPrmDflt(data,dfs,1);
+  'xMin',[], 'xStep',[], 'xType',[], 'hist0',[], 'hist1',[] };
+[X0,X1,wts0,wts1,xMin,xStep,xType,hist0,hist1]=getPrmDflt(data,dfs,1);
 [N0,F]=size(X0); [N1,F1]=size(X1); assert(F==F1);
 if(isempty(xType)), xMin=zeros(1,F); xStep=ones(1,F); xType=class(X0); end
 assert(isfloat(wts0)); if(isempty(wts0)), wts0=ones(N0,1)/N0; end
 assert(isfloat(wts1)); if(isempty(wts1)), wts1=ones(N1,1)/N1; end
-w=sum(wts0)+sum(wts1); if(abs(w-1)>1e-3), wts0=wts0/w; wts1=wts1/w; end
+w=sum(wts0)+sum(wts1); if(abs(w-1)>1e-3), wts0=wts0/w; wts1=wts1/w;
+  hist0=hist0/w; hist1=hist1/w; end
 
 % quantize data to be between [0,nBins-1] if not already quantized
 if( ~isa(X0,'uint8') || ~isa(X1,'uint8') )
@@ -82,6 +107,7 @@ if( ~isa(X0,'uint8') || ~isa(X1,'uint8') )
   xStep = (xMax-xMin) / (nBins-1);
   X0 = uint8(bsxfun(@times,bsxfun(@minus,X0,xMin),1./xStep));
   X1 = uint8(bsxfun(@times,bsxfun(@minus,X1,xMin),1./xStep));
+  hist0=[]; hist1=[];
 end
 data=struct( 'X0',X0, 'X1',X1, 'wts0',wts0, 'wts1',wts1, ...
   'xMin',xMin, 'xStep',xStep, 'xType',xType );
@@ -91,7 +117,12 @@ K=2*(N0+N1); thrs=zeros(K,1,xType);
 hs=zeros(K,1,'single'); weights=hs; errs=hs;
 fids=zeros(K,1,'uint32'); child=fids; depth=fids;
 wtsAll0=cell(K,1); wtsAll0{1}=wts0;
-wtsAll1=cell(K,1); wtsAll1{1}=wts1; k=1; K=2;
+wtsAll1=cell(K,1); wtsAll1{1}=wts1;
+useHist=useHist || nargout>=4 || ~isempty(hist0);
+if(useHist && isempty(hist0)), [~,~,hist0,hist1]=binaryTreeTrain1(...
+    X0,X1,single(wts0),single(wts1),nBins,.5,uint32(0:F-1),nThreads); end
+if(useHist), histAll0=cell(K,1); histAll0{1}=hist0;
+  histAll1=cell(K,1); histAll1{1}=hist1; end; k=1; K=2;
 while( k < K )
   % get node weights and prior
   wts0=wtsAll0{k}; wtsAll0{k}=[]; w0=sum(wts0);
@@ -103,8 +134,15 @@ while( k < K )
     k=k+1; continue; end
   % train best stump
   fidsSt=1:F; if(fracFtrs<1), fidsSt=randperm(F,floor(F*fracFtrs)); end
-  [errsSt,thrsSt] = binaryTreeTrain1(X0,X1,single(wts0/w),...
-    single(wts1/w),nBins,prior,uint32(fidsSt-1),nThreads);
+  if( useHist )
+    h0=histAll0{k}; h1=histAll1{k};
+    if(fracFtrs<1), h0=h0(:,fidsSt); h1=h1(:,fidsSt); end
+    [errsSt,thrsSt] = binaryTreeTrain1(X0,X1,[],[],nBins,prior,...
+      uint32(fidsSt-1),nThreads,[],[],h0,h1);
+  else
+    [errsSt,thrsSt] = binaryTreeTrain1(X0,X1,single(wts0/w),...
+      single(wts1/w),nBins,prior,uint32(fidsSt-1),nThreads);
+  end
   [~,fid]=min(errsSt); thr=single(thrsSt(fid))+.5; fid=fidsSt(fid);
   % split data and continue
   left0=X0(:,fid)<thr; left1=X1(:,fid)<thr;
@@ -113,7 +151,17 @@ while( k < K )
     child(k)=K; fids(k)=fid-1; thrs(k)=thr;
     wtsAll0{K}=wts0.*left0; wtsAll0{K+1}=wts0.*~left0;
     wtsAll1{K}=wts1.*left1; wtsAll1{K+1}=wts1.*~left1;
-    depth(K:K+1)=depth(k)+1; K=K+2;
+    depth(K:K+1)=depth(k)+1;
+    % compute smaller child's histograms (sibling's are by subtraction)
+    if( useHist && (nargout>=4 || depth(k)+1<maxDepth) )
+      nL=nnz(wtsAll0{K})+nnz(wtsAll1{K}); c=K+1; s=K;
+      nR=nnz(wtsAll0{K+1})+nnz(wtsAll1{K+1}); if(nL<=nR), c=K; s=K+1; end
+      o0=find(wtsAll0{c}); o1=find(wtsAll1{c});
+      [~,~,histAll0{c},histAll1{c},histAll0{s},histAll1{s}]=...
+        binaryTreeTrain1(X0,X1,single(wtsAll0{c}(o0)),...
+        single(wtsAll1{c}(o1)),nBins,.5,uint32(0:F-1),nThreads,...
+        uint32(o0-1),uint32(o1-1),histAll0{k},histAll1{k});
+    end; if(useHist), histAll0{k}=[]; histAll1{k}=[]; end; K=K+2;
   end; k=k+1;
 end; K=K-1;
 
@@ -121,5 +169,8 @@ end; K=K-1;
 tree=struct('fids',fids(1:K),'thrs',thrs(1:K),'child',child(1:K),...
   'hs',hs(1:K),'weights',weights(1:K),'depth',depth(1:K));
 if(nargout>=3), err=sum(errs(1:K).*tree.weights.*(tree.child==0)); end
+if(nargout>=4), leaves=find(tree.child==0);
+  hists=struct('leaves',leaves,'hist0',cat(3,histAll0{leaves}),...
+    'hist1',cat(3,histAll1{leaves})); end
 
 end
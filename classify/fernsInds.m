@@ -1,13 +1,19 @@
-function inds = fernsInds( data, fids, thrs )
+function inds = fernsInds( data, fids, thrs, nThreads )
 % Compute indices for each input by each fern.
 %
+% The data may be of type double, single or uint8 (thrs are always double
+% and comparisons are exact for all types). Ferns are processed in parallel
+% and for each fern the S bits of a block of inputs are computed at once
+% while streaming over the S data columns (allowing for vectorization).
+%
 % USAGE
-%  inds = fernsInds( data, fids, thrs )
+%  inds = fernsInds( data, fids, thrs, [nThreads] )
 %
 % INPUTS
 %  data     - [NxF] N length F binary feature vectors
-%  fids     - [MxS] feature ids for each fern for each depth
+%  fids     - [MxS] feature ids for each fern for each depth (S<=32)
 %  thrs     - [MxS] threshold corresponding to each fid
+%  nThreads - [16] max number of computational threads to use
 %
 % OUTPUTS
 %  inds     - [NxM] computed indices for each input by each fern
@@ -20,7 +26,10 @@ function inds = fernsInds( data, fids, thrs )
 % Copyright 2014 Piotr Dollar.  [pdollar-at-gmail.com]
 % Licensed under the Simplified BSD License [see external/bsd.txt]
 
-inds = fernsInds1( data, fids, thrs );
+if(nargin<4 || isempty(nThreads)), nThreads=16; end
+if(~isa(fids,'uint32')), fids=uint32(fids); end
+if(~isa(thrs,'double')), thrs=double(thrs); end
+inds = fernsInds1( data, fids, thrs, nThreads );
 
 %%% OLD MATLAB CODE -- NOW IN MEX
 % [M,S]=size(fids); N=size(data,1);
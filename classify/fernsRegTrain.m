@@ -14,6 +14,12 @@ function [ferns,ysPr] = fernsRegTrain( data, ys, varargin )
 % achieve good performance, especially on noisy data. In general, eta
 % should decreased as M is increased.
 %
+% Training is performed natively (fernsRegTrain1). The random ferns are
+% drawn up front (in the same order as they would be drawn sequentially)
+% and the R ferns of each phase are trained and evaluated in parallel using
+% up to nThreads threads. For the 'exp' loss the line search for the fern
+% scale of all R ferns starts from the best scale of the previous phase.
+%
 % Dimensions:
 %  M - number ferns
 %  R - number repeats
@@ -37,6 +43,7 @@ function [ferns,ysPr] = fernsRegTrain( data, ys, varargin )
 %   .reg      - [0.01] fern regularization term in [0,1]
 %   .eta      - [1] learning rate in [0,1] (not used if type='ave')
 %   .verbose  - [0] if true output info to display
+%   .nThreads - [16] max number of computational threads to use
 %
 % OUTPUTS
 %  ferns    - learned fern model w the following fields
@@ -70,51 +77,23 @@ function [ferns,ysPr] = fernsRegTrain( data, ys, varargin )
 
 % get/check parameters
 dfs={'type','res','loss','L2','S',2,'M',50,'R',10,'thrr',[0 1],...
-  'reg',0.01,'eta',1,'verbose',0};
-[type,loss,S,M,R,thrr,reg,eta,verbose]=getPrmDflt(varargin,dfs,1);
+  'reg',0.01,'eta',1,'verbose',0,'nThreads',16};
+[type,loss,S,M,R,thrr,reg,eta,verbose,nThreads]=getPrmDflt(varargin,dfs,1);
 type=type(1:3); assert(any(strcmp(type,{'res','ave'})));
-assert(any(strcmp(loss,{'L1','L2','exp'}))); N=length(ys);
+lossId=find(strcmp(loss,{'L1','L2','exp'}))-1; assert(~isempty(lossId));
 if(strcmp(type,'ave')), eta=1; end
-% train stagewise regressor (residual or average)
-fids=zeros(M,S,'uint32'); thrs=zeros(M,S);
-ysSum=zeros(N,1); ysFern=zeros(2^S,M);
-for m=1:M
-  % train R random ferns using different losses, keep best
-  if(strcmp(type,'ave')), d=m; else d=1; end
-  ysTar=d*ys-ysSum; best={};
-  if(strcmp(loss,'L1')), e=sum(abs(ysTar));
-    for r=1:R
-      [fids1,thrs1,ysFern1,ys1]=trainFern(data,sign(ysTar),S,thrr,reg);
-      a=medianw(ysTar./ys1,abs(ys1)); ysFern1=ysFern1*a; ys1=ys1*a;
-      e1=sum(abs(ysTar-ys1));
-      if(e1<=e), e=e1; best={fids1,thrs1,ysFern1,ys1}; end
-    end
-  elseif(strcmp(loss,'L2')), e=sum(ysTar.^2);
-    for r=1:R
-      [fids1,thrs1,ysFern1,ys1]=trainFern(data,ysTar,S,thrr,reg);
-      e1=sum((ysTar-ys1).^2);
-      if(e1<=e), e=e1; best={fids1,thrs1,ysFern1,ys1}; end
-    end
-  elseif(strcmp(loss,'exp')), e=sum(exp(ysTar/d)+exp(-ysTar/d));
-    ysDeriv=exp(ysTar/d)-exp(-ysTar/d);
-    for r=1:R
-      [fids1,thrs1,ysFern1,ys1]=trainFern(data,ysDeriv,S,thrr,reg);
-      e1=inf; if(m==1), aBst=1; end; aMin=aBst/5; aMax=aBst*5;
-      for phase=1:3, aDel=(aMax-aMin)/10;
-        for a=aMin:aDel:aMax
-          eTmp=sum(exp((ysTar-a*ys1)/d)+exp((a*ys1-ysTar)/d));
-          if(eTmp<e1), a1=a; e1=eTmp; end
-        end; aMin=a1-aDel; aMax=a1+aDel;
-      end; ysFern1=ysFern1*a1; ys1=ys1*a1;
-      if(e1<=e), e=e1; aBst=a1; best={fids1,thrs1,ysFern1,ys1}; end
-    end
-  end
-  % store results and update sums
-  assert(~isempty(best)); [fids1,thrs1,ysFern1,ys1]=deal(best{:});
-  fids(m,:)=fids1; thrs(m,:)=thrs1;
-  ysFern(:,m)=ysFern1*eta; ysSum=ysSum+ys1*eta;
-  if(verbose), fprintf('phase=%i  error=%f\n',m,e); end
+% generate random fern proposals (R per phase)
+[N,F]=size(data); assert(length(ys)==N);
+fidsR=zeros(M*R,S,'uint32'); thrsR=zeros(M*R,S);
+for j=1:M*R
+  fidsR(j,:) = uint32(floor(rand(1,S)*F+1));
+  thrsR(j,:) = rand(1,S)*(thrr(2)-thrr(1))+thrr(1);
 end
+% train stagewise regressor (residual or average)
+if(~isa(data,'double') && ~isa(data,'single') && ~isa(data,'uint8'))
+  data=double(data); end
+[fids,thrs,ysFern,ysSum]=fernsRegTrain1(data,double(ys(:)),fidsR,thrsR,...
+  M,strcmp(type,'ave'),lossId,reg,eta,verbose,nThreads);
 % create output struct
 if(strcmp(type,'ave')), d=M; else d=1; end; clear data;
 ferns=struct('fids',fids,'thrs',thrs,'ysFern',ysFern/d); ysPr=ysSum/d;
@@ -125,24 +104,3 @@ switch loss
 end
 end
 
-function [fids,thrs,ysFern,ysPr] = trainFern( data, ys, S, thrr, reg )
-% Train single random fern regressor.
-[N,F]=size(data); mu=sum(ys)/N; ys=ys-mu;
-fids = uint32(floor(rand(1,S)*F+1));
-thrs = rand(1,S)*(thrr(2)-thrr(1))+thrr(1);
-inds = fernsInds(data,fids,thrs);
-ysFern=zeros(2^S,1); cnts=zeros(2^S,1);
-for n=1:N, ind=inds(n);
-  ysFern(ind)=ysFern(ind)+ys(n);
-  cnts(ind)=cnts(ind)+1;
-end
-ysFern = ysFern ./ max(cnts+reg*N,eps) + mu;
-ysPr = ysFern(inds);
-end
-
-function m = medianw(x,w)
-% Compute weighted median of x.
-[x,ord]=sort(x(:)); w=w(ord);
-[~,ind]=max(cumsum(w)>=sum(w)/2);
-m = x(ind);
-end
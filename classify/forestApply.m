@@ -1,12 +1,21 @@
 function [hs,ps] = forestApply( data, forest, maxDepth, minCount, best )
 % Apply learned forest classifier.
 %
+% All trees are applied in a single pass over the data: samples are
+% processed in small blocks and every tree is applied to a block (and the
+% leaf distributions accumulated) before moving on to the next block.
+%
+% The forest may also be given in the packed format created by forestPack
+% (either as the uint8 array or as the name of the file it was saved to, in
+% which case the file is memory mapped). Packed forests are evaluated
+% directly and do not support maxDepth, minCount or best.
+%
 % USAGE
 %  [hs,ps] = forestApply( data, forest, [maxDepth], [minCount], [best] )
 %
 % INPUTS
 %  data     - [NxF] N length F feature vectors
-%  forest   - learned forest classification model
+%  forest   - learned forest classification model or packed forest
 %  maxDepth - [] maximum depth of tree
 %  minCount - [] minimum number of data points to allow split
 %  best     - [0] if true use single best prediction per tree
@@ -17,7 +26,7 @@ function [hs,ps] = forestApply( data, forest, maxDepth, minCount, best )
 %
 % EXAMPLE
 %
-% See also forestTrain
+% See also forestTrain, forestPack
 %
 % Piotr's Computer Vision Matlab Toolbox      Version 3.24
 % Copyright 2014 Piotr Dollar.  [pdollar-at-gmail.com]
@@ -25,16 +34,33 @@ function [hs,ps] = forestApply( data, forest, maxDepth, minCount, best )
 if(nargin<3 || isempty(maxDepth)), maxDepth=0; end
 if(nargin<4 || isempty(minCount)), minCount=0; end
 if(nargin<5 || isempty(best)), best=0; end
-assert(isa(data,'single')); M=length(forest);
+assert(isa(data,'single'));
+if(ischar(forest) || isa(forest,'uint8'))
+  if(maxDepth>0 || minCount>0 || best)
+    error('maxDepth, minCount and best not supported for packed forests.'); end
+  [ps,M]=forestIndsPacked(data,forest,[],1); [~,hs]=max(ps,[],2);
+  ps=single(ps/M);
+  return;
+end
+M=length(forest);
 H=size(forest(1).distr,2); N=size(data,1);
-if(best), hs=zeros(N,M); else ps=zeros(N,H); end
-discr=iscell(forest(1).hs); if(discr), best=1; hs=cell(N,M); end
-for i=1:M, tree=forest(i);
+discr=iscell(forest(1).hs); if(discr), best=1; end
+% pack all trees into [KxM] arrays (shorter trees are padded with leaves)
+K=zeros(1,M); for i=1:M, K(i)=length(forest(i).fids); end
+thrs=zeros(max(K),M,'single'); fids=zeros(max(K),M,'uint32'); child=fids;
+if(~best), distr=zeros(max(K),H,M,'single'); end
+for i=1:M, tree=forest(i); k=1:K(i);
   if(maxDepth>0), tree.child(tree.depth>=maxDepth) = 0; end
   if(minCount>0), tree.child(tree.count<=minCount) = 0; end
-  ids = forestInds(data,tree.thrs,tree.fids,tree.child);
-  if(best), hs(:,i)=tree.hs(ids); else ps=ps+tree.distr(ids,:); end
+  thrs(k,i)=tree.thrs; fids(k,i)=tree.fids; child(k,i)=tree.child;
+  if(~best), distr(k,:,i)=tree.distr; end
+end
+% apply all trees in single pass over data (in blocks of samples)
+if(~best), ps=forestInds(data,thrs,fids,child,[],distr); else
+  ids=forestInds(data,thrs,fids,child); if(discr), hs=cell(N,M); else
+    hs=zeros(N,M); end; for i=1:M, hs(:,i)=forest(i).hs(ids(:,i)); end
 end
 if(discr), ps=[]; return; end % output is actually {NxM} in this case
 if(best), ps=histc(hs',1:H)'; end; [~,hs]=max(ps,[],2); ps=ps/M;
+if(~best), ps=single(ps); end % leaf distrs are accumulated in double
 end
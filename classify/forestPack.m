@@ -0,0 +1,90 @@
+function blob = forestPack( forest, fName )
+% Pack learned forest classifier into a compact contiguous format.
+%
+% A forest (see forestTrain) is a struct array that stores every tree as a
+% set of separate fids/thrs/child/distr/hs arrays. forestPack serializes all
+% trees into a single uint8 array that forestApply can evaluate directly.
+% The nodes of every tree are stored in breadth first order as 8 byte
+% records: a uint16 feature id, the uint16 index of the left child within
+% the tree (the right child follows it, 0 indicates a leaf) and either the
+% single precision threshold or, at leaves, the index of the leaf. The
+% leaf distributions are quantized to uint16 (in units of 1/65535) and are
+% stored contiguously after the nodes. The thresholds are kept at full
+% single precision (forestTrain produces single thresholds and rounding
+% them would alter the leaves reached). The original node index of every
+% leaf is kept so that node indices identical to forestInds are available.
+%
+% If fName is given the packed forest is also written to disk, and the file
+% name can then be passed to forestApply in place of the forest. Model files
+% are memory mapped (read only) the first time they are used and remain
+% mapped until the mex file is cleared, so loading is nearly free and the
+% pages are shared by all processes that use the same model.
+%
+% The format (little endian) consists of the following consecutive parts:
+%  header   - 8 uint32: 'PFST', version (1), M, H, F, nNodes, nLeaves, 0
+%  offsets  - [M+1] uint32 index of first node of each tree (the last entry
+%             is nNodes), followed by one uint32 of padding if M+1 is odd
+%  nodes    - [nNodes] 8 byte node records (see above)
+%  leafIds  - [nLeaves] uint32 original (1-based) node index of each leaf
+%  distr    - [H x nLeaves] uint16 quantized leaf distributions
+% Each tree may have at most 65536 nodes and feature ids must be <65536.
+%
+% USAGE
+%  blob = forestPack( forest, [fName] )
+%
+% INPUTS
+%  forest   - learned forest classification model (see forestTrain)
+%  fName    - [] optional file to which to write the packed forest
+%
+% OUTPUTS
+%  blob     - [nx1] uint8 packed forest
+%
+% EXAMPLE
+%  N=10000; H=5; d=2; [xs0,hs0,xs1,hs1]=demoGenData(N,N,H,d,1,1);
+%  xs0=single(xs0); xs1=single(xs1);
+%  forest=forestTrain(xs0,hs0,'maxDepth',50,'F1',2,'M',150,'minChild',5);
+%  forestPack(forest,'forest.pfst');
+%  [hs0,ps0]=forestApply(xs1,forest);
+%  [hs1,ps1]=forestApply(xs1,'forest.pfst');
+%  mean(hs0~=hs1), max(abs(ps0(:)-ps1(:)))
+%
+% See also forestTrain, forestApply
+%
+% Piotr's Computer Vision Matlab Toolbox      Version 3.50
+% Copyright 2014 Piotr Dollar.  [pdollar-at-gmail.com]
+% Licensed under the Simplified BSD License [see external/bsd.txt]
+
+if(nargin<2), fName=[]; end
+if(iscell(forest(1).hs)), error('Discrete forests cannot be packed.'); end
+M=length(forest); H=size(forest(1).distr,2); F=0; nLeaves=0;
+offs=zeros(1,M+1); nodes=cell(1,M); leafIds=nodes; distr=nodes;
+for i=1:M, t=forest(i); child=double(t.child(:));
+  % breadth first node order (the two children of a node are adjacent)
+  order=1; j=1; while(j<=length(order)), k=order(j); j=j+1;
+    if(child(k)), order=[order child(k)+[0 1]]; end %#ok<AGROW>
+  end
+  K=length(order); if(K>65536), error('Tree %i has too many nodes.',i); end
+  ids=zeros(1,length(child)); ids(order)=0:K-1; c=child(order)';
+  leaf=c==0; left=zeros(1,K); left(~leaf)=ids(c(~leaf));
+  fids=double(t.fids(order)'); fids(leaf)=0; F=max([F fids+1]);
+  if(F>65536), error('Feature ids must be smaller than 65536.'); end
+  pay=typecast(single(t.thrs(order)'),'uint32'); nl=nnz(leaf);
+  pay(leaf)=uint32(nLeaves+(0:nl-1));
+  % node records [fid left thr/leaf] and quantized leaf distributions
+  nodes{i}=[reshape(typecast(uint16(fids),'uint8'),2,K);
+    reshape(typecast(uint16(left),'uint8'),2,K);
+    reshape(typecast(pay,'uint8'),4,K)];
+  leafIds{i}=uint32(order(leaf));
+  distr{i}=uint16(t.distr(order(leaf),:)'*65535);
+  offs(i+1)=offs(i)+K; nLeaves=nLeaves+nl;
+end
+% concatenate header, tree offsets, nodes, leaf ids and distributions
+hdr=[typecast(uint8('PFST'),'uint32') uint32([1 M H F offs(end) nLeaves 0])];
+if(mod(M+1,2)), offs(end+1)=0; end; nodes=[nodes{:}]; distr=[distr{:}];
+blob=[typecast(hdr,'uint8') typecast(uint32(offs),'uint8') nodes(:)' ...
+  typecast([leafIds{:}],'uint8') typecast(distr(:)','uint8')]';
+if(isempty(fName)), return; end
+fid=fopen(fName,'w'); if(fid<0), error('Unable to open %s.',fName); end
+fwrite(fid,blob,'uint8'); fclose(fid);
+
+end
@@ -26,6 +26,25 @@ function forest = forestTrain( data, hs, varargin )
 %   .fWts       - [] weights used for sampling features
 %   .discretize - [] optional function mapping structured to class labels
 %                    format: [hsClass,hBest] = discretize(hsStructured,H);
+%   .nBins      - [0] if >0 quantize features to nBins<=256 bins for splits
+%   .nThreads   - [16] max number of computational threads to use
+%
+% If nBins>0, each feature is quantized once (prior to training any trees)
+% into nBins bins using quantiles of the feature's values. Node splits are
+% then found by building per class weighted histograms for each candidate
+% feature and scanning the bin boundaries, as opposed to sorting the node's
+% data for every candidate feature. This reduces memory and time per node
+% to O(N*F1) at the cost of restricting thresholds to the bin boundaries.
+% Useful for training on very large datasets.
+%
+% Unless discretize is specified, all M trees are grown by a native (C++)
+% implementation. The samples of each node are kept as an in place partition
+% of the tree's sample indices, and the nodes of all trees are processed one
+% level at a time, with the nodes at each level distributed across nThreads
+% threads. Node numbering is identical to the breadth first order used
+% otherwise, and the result does not depend on the number of threads. When
+% discretize is specified, trees are trained one node at a time in Matlab
+% (discretize is applied to the labels at every node).
 %
 % OUTPUTS
 %  forest   - learned forest model struct array w the following fields
@@ -59,9 +78,10 @@ function forest = forestTrain( data, hs, varargin )
 
 % get additional parameters and fill in remaining parameters
 dfs={ 'M',1, 'H',[], 'N1',[], 'F1',[], 'split','gini', 'minCount',1, ...
-  'minChild',1, 'maxDepth',64, 'dWts',[], 'fWts',[], 'discretize','' };
-[M,H,N1,F1,splitStr,minCount,minChild,maxDepth,dWts,fWts,discretize] = ...
-  getPrmDflt(varargin,dfs,1);
+  'minChild',1, 'maxDepth',64, 'dWts',[], 'fWts',[], 'discretize','', ...
+  'nBins',0, 'nThreads',16 };
+[M,H,N1,F1,splitStr,minCount,minChild,maxDepth,dWts,fWts,discretize,...
+  nBins,nThreads] = getPrmDflt(varargin,dfs,1);
 [N,F]=size(data); assert(length(hs)==N); discr=~isempty(discretize);
 minChild=max(1,minChild); minCount=max([1 minCount minChild]);
 if(isempty(H)), H=max(hs); end; assert(discr || all(hs>0 & hs<=H));
@@ -78,22 +98,40 @@ if(~isa(hs,'uint32') && ~discr), hs=uint32(hs); end
 if(~isa(fWts,'single')), fWts=single(fWts); end
 if(~isa(dWts,'single')), dWts=single(dWts); end
 
+% optionally quantize features (once for all trees)
+if(nBins), [dataQ,edges]=quantize(data,nBins); else dataQ=[]; edges=[]; end
+
+% train all trees at once using native tree grower (if not discretizing)
+if( ~discr )
+  dids=zeros(N1,M,'uint32'); ws=zeros(N1,M,'single');
+  for i=1:M
+    if(N==N1), d=1:N; else d=wswor(dWts,N1,4); end
+    dids(:,i)=d-1; ws(:,i)=dWts(d)/sum(dWts(d));
+  end
+  if(nBins), data=dataQ; end; seed=randi(2^31-1);
+  forest=forestTrain1(data,edges,hs,dids,ws,fWts,H,F1,minCount,...
+    minChild,maxDepth,split,seed,nThreads); return;
+end
+
 % train M random trees on different subsets of data
-prmTree = {H,F1,minCount,minChild,maxDepth,fWts,split,discretize};
+prmTree = {H,F1,minCount,minChild,maxDepth,fWts,split,discretize,edges,...
+  nThreads};
 for i=1:M
-  if(N==N1), data1=data; hs1=hs; dWts1=dWts; else
+  if(N==N1), data1=data; dataQ1=dataQ; hs1=hs; dWts1=dWts; else
     d=wswor(dWts,N1,4); data1=data(d,:); hs1=hs(d);
     dWts1=dWts(d); dWts1=dWts1/sum(dWts1);
+    if(nBins), dataQ1=dataQ(d,:); else dataQ1=[]; end
   end
-  tree = treeTrain(data1,hs1,dWts1,prmTree);
+  tree = treeTrain(data1,dataQ1,hs1,dWts1,prmTree);
   if(i==1), forest=tree(ones(M,1)); else forest(i)=tree; end
 end
 
 end
 
-function tree = treeTrain( data, hs, dWts, prmTree )
+function tree = treeTrain( data, dataQ, hs, dWts, prmTree )
 % Train single random tree.
-[H,F1,minCount,minChild,maxDepth,fWts,split,discretize]=deal(prmTree{:});
+[H,F1,minCount,minChild,maxDepth,fWts,split,discretize,edges,nThreads]=...
+  deal(prmTree{:});
 N=size(data,1); K=2*N-1; discr=~isempty(discretize);
 thrs=zeros(K,1,'single'); distr=zeros(K,H,'single');
 fids=zeros(K,1,'uint32'); child=fids; count=fids; depth=fids;
@@ -108,9 +146,12 @@ while( k < K )
   % if pure node or insufficient data don't train split
   if( pure || n1<=minCount || depth(k)>maxDepth ), k=k+1; continue; end
   % train split and continue
-  fids1=wswor(fWts,F1,4); data1=data(dids1,fids1);
-  [~,order1]=sort(data1); order1=uint32(order1-1);
-  [fid,thr,gain]=forestFindThr(data1,hs1,dWts(dids1),order1,H,split);
+  fids1=wswor(fWts,F1,4);
+  if(isempty(edges)), data1=data(dids1,fids1);
+    [~,order1]=sort(data1); order1=uint32(order1-1); else
+    data1=dataQ(dids1,fids1); order1=edges(:,fids1); end
+  [fid,thr,gain]=forestFindThr(data1,hs1,dWts(dids1),order1,H,split,...
+    nThreads);
   fid=fids1(fid); left=data(dids1,fid)<thr; count0=nnz(left);
   if( gain>1e-10 && count0>=minChild && (n1-count0)>=minChild )
     child(k)=K; fids(k)=fid-1; thrs(k)=thr;
@@ -124,6 +165,19 @@ tree=struct('fids',fids(K),'thrs',thrs(K),'child',child(K),...
   'distr',distr(K,:),'hs',hsn,'count',count(K),'depth',depth(K));
 end
 
+function [dataQ,edges] = quantize( data, nBins )
+% Quantize each feature into nBins bins (bin(x) is the number of edges<=x).
+[N,F]=size(data); nBins=min(256,max(2,nBins)); dataQ=zeros(N,F,'uint8');
+edges=inf(nBins-1,F,'single'); ids=1:N; if(N>1e5), ids=randperm(N,1e5); end
+n=length(ids); qs=ceil((1:nBins-1)/nBins*n);
+for f=1:F
+  x=sort(data(ids,f)); e=unique(x(qs)); e=e(~isnan(e)); m=length(e);
+  [~,b]=histc(data(:,f),[-inf; e(:); inf]); edges(1:m,f)=e;
+  b(isnan(data(:,f)))=m+1; % nan goes to top bin (and right, as in forestInds)
+  dataQ(:,f)=uint8(min(max(b,1),m+1)-1);
+end
+end
+
 function ids = wswor( prob, N, trials )
 % Fast weighted sample without replacement. Alternative to:
 %  ids=datasample(1:length(prob),N,'weights',prob,'replace',false);
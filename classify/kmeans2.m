@@ -24,6 +24,17 @@ function [ IDX, C, d ] = kmeans2( X, k, varargin )
 % the given point does not belong to any of the discovered clusters. Note
 % that matlab's version of kmeans does not have outliers.
 %
+% For the (squared) euclidean metric the iterations are run by a compiled
+% engine that keeps bounds on the distance of every point to its nearest
+% and to the other centers, skipping most distance computations once the
+% centers start to settle (results are unchanged). Hamerly's variant keeps
+% one lower bound per point, Elkan's one per point and center (more
+% pruning but 8*n*k bytes of memory). By default Elkan's variant is used
+% when n*k is at most 2^22 (at most 32MB of bounds), Hamerly's otherwise.
+% The assignment step runs on up to nThreads threads. For all other
+% metrics (or if the engine is not compiled, see toolboxCompile) pdist2's
+% nearest neighbor mode is used every iteration.
+%
 % USAGE
 %  [ IDX, C, d ] = kmeans2( X, k, [varargin] )
 %
@@ -40,6 +51,8 @@ function [ IDX, C, d ] = kmeans2( X, k, varargin )
 %   .minCl     - [1] min cluster size (smaller clusters get eliminated)
 %   .metric    - [] metric for pdist2
 %   .C0        - [] initial cluster centers for first trial
+%   .bounds    - ['auto'] 'hamerly' or 'elkan' bounds for euclidean metric
+%   .nThreads  - [16] max number of computational threads to use
 %
 % OUTPUTS
 %  IDX    - [n x 1] cluster membership (see above)
@@ -57,14 +70,16 @@ function [ IDX, C, d ] = kmeans2( X, k, varargin )
 
 % get input args
 dfs = {'nTrial',1, 'maxIter',100, 'display',0, 'rndSeed',[],...
-  'outFrac',0, 'minCl',1, 'metric',[], 'C0',[],'k',k };
-[nTrial,maxt,dsp,rndSeed,outFrac,minCl,metric,C0,k] = ...
+  'outFrac',0, 'minCl',1, 'metric',[], 'C0',[],'k',k, 'bounds','auto',...
+  'nThreads',16 };
+[nTrial,maxt,dsp,rndSeed,outFrac,minCl,metric,C0,k,bounds,nThreads] = ...
   getPrmDflt(varargin,dfs); assert(~isempty(k) && k>0);
 
 % error checking
 if(k<1); error('k must be greater than 1'); end
 if(~ismatrix(X) || any(size(X)==0)); error('Illegal X'); end
 if(outFrac<0 || outFrac>=1), error('outFrac must be in [0,1)'); end
+if(~any(strcmp(bounds,{'auto','hamerly','elkan'}))), error('bad bounds'); end
 nOut = floor( size(X,1)*outFrac );
 
 % initialize random seed if specified
@@ -74,21 +89,22 @@ if(~isempty(rndSeed)); rand('state',rndSeed); end; %#ok<RAND>
 bd=inf; t0=clock;
 for i=1:nTrial, t1=clock; if(i>1), C0=[]; end
   if(dsp), fprintf('kmeans2 iter %i/%i step: ',i,nTrial); end
-  [IDX,C,d]=kmeans2main(X,k,nOut,minCl,maxt,dsp,metric,C0);
+  [IDX,C,d]=kmeans2main(X,k,nOut,minCl,maxt,dsp,metric,C0,bounds,nThreads);
   if(sum(d)<sum(bd)), bIDX=IDX; bC=C; bd=d; end
   if(dsp), fprintf('  d=%f  t=%fs\n',sum(d),etime(clock,t1)); end
 end
-IDX=bIDX; C=bC; d=bd; k=max(IDX);
+IDX=bIDX; C=bC; d=bd; k=max([0; IDX]);
 if(dsp), fprintf('k=%i  d=%f  t=%fs\n',k,sum(d),etime(clock,t0)); end
 
 % sort IDX to have biggest clusters have lower indicies
-cnts = zeros(1,k); for i=1:k; cnts(i) = sum( IDX==i ); end
+cnts = accumarray(IDX(IDX>0),1,[k 1])';
 [~,order] = sort( -cnts ); C = C(order,:); d = d(order);
-IDX2=IDX; for i=1:k; IDX2(IDX==order(i))=i; end; IDX = IDX2;
+rnk(order)=1:k; IDX(IDX>0)=rnk(IDX(IDX>0));
 
 end
 
-function [IDX,C,d] = kmeans2main( X, k, nOut, minCl, maxt, dsp, metric, C )
+function [IDX,C,d] = kmeans2main( X, k, nOut, minCl, maxt, dsp, metric, ...
+  C, bounds, nThreads )
 
 % initialize cluster centers to be k random X points
 [N,p] = size(X); k = min(k,N); t=0;
@@ -96,10 +112,24 @@ IDX = ones(N,1); oldIDX = zeros(N,1);
 if(isempty(C)), C = X(randperm(N,k),:)+randn(k,p)/1e5; end
 
 % MAIN LOOP: loop until the cluster assigments do not change
-if(dsp), nDg=ceil(log10(maxt-1)); fprintf(int2str2(0,nDg)); end
+nDg=0; if(dsp), nDg=ceil(log10(maxt-1)); fprintf(int2str2(0,nDg)); end
+if( (isempty(metric) || isequal(metric,0) || ...
+    any(strcmp(metric,{'sqeuclidean','euclidean'}))) && ...
+    exist('kmeans2Mex','file')==3 )
+  % compiled engine (reseeds with a random point if all clusters vanish)
+  if(strcmp(bounds,'auto')), elkan=N*k<=2^22; else
+    elkan=strcmp(bounds,'elkan'); end
+  if(isa(X,'single')), Xt=X'; else Xt=double(X)'; end; reseed=2;
+  while( reseed==2 )
+    [IDX,C,mind,t1,reseed] = kmeans2Mex(Xt,double(C'),nOut,minCl,...
+      maxt-t,elkan,~strcmp(metric,'euclidean'),nDg,nThreads,IDX);
+    t=t+t1; C=C'; if(reseed), C=X(randint2(1,1,[1 N]),:); end
+  end
+  k=size(C,1); oldIDX=IDX;
+end
 while( any(oldIDX~=IDX) && t<maxt )
   % assign each point to closest cluster center
-  oldIDX=IDX; D=pdist2(X,C,metric); [mind,IDX]=min(D,[],2);
+  oldIDX=IDX; [mind,IDX]=pdist2(X,C,metric,1,nThreads);
   
   % do not use most distant nOut elements in computation of centers
   mind1=sort(mind); thr=mind1(end-nOut); IDX(mind>thr)=-1;
@@ -116,6 +146,6 @@ while( any(oldIDX~=IDX) && t<maxt )
 end
 
 % record within-cluster sums of point-to-centroid distances
-d=zeros(1,k); for i=1:k, d(i)=sum(mind(IDX==i)); end
+d=accumarray(IDX(IDX>0),mind(IDX>0),[k 1])';
 
 end
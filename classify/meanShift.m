@@ -1,4 +1,5 @@
-function [IDX,M] = meanShift(X, radius, rate, maxIter, minCsize, blur )
+function [IDX,M] = meanShift(X, radius, rate, maxIter, minCsize, blur, ...
+  nThreads, kernel )
 % meanShift clustering algorithm.
 %
 % Based on code from Sameer Agarwal <sagarwal-at-cs.ucsd.edu>.
@@ -23,8 +24,23 @@ function [IDX,M] = meanShift(X, radius, rate, maxIter, minCsize, blur )
 % different points).  Hence M is not the same as C, the centroid of the
 % points [see kmeans2 for a definition of C].
 %
+% To avoid comparing every point to every other point, the points are
+% bucketed into a uniform grid (with cells of width at least radius) over
+% the (up to) three dimensions with largest extent, and only points in
+% adjacent cells are compared. The grid is most effective if the data is
+% low dimensional or has a few dominant dimensions. Points are shifted in
+% parallel using up to nThreads threads. If X is single, computations are
+% performed in single precision (distances to multiple points are computed
+% at once using SSE), which is faster for high dimensional data (results
+% may differ slightly from double precision for points that lie almost
+% exactly at distance radius or at the convergence tolerance). By
+% default all points within radius are weighted equally ('flat' kernel),
+% if kernel='gauss' points are weighted by a Gaussian with sigma=radius/3
+% (truncated at radius).
+%
 % USAGE
-%  [IDX,M] = meanShift(X, radius, [rate], [maxIter], [minCsize], [blur] )
+%  [IDX,M] = meanShift(X,radius,[rate],[maxIter],[minCsize],[blur],...
+%    [nThreads],[kernel])
 %
 % INPUTS
 %  X           - column vector of data - N vectors of dim p (X is Nxp)
@@ -34,6 +50,8 @@ function [IDX,M] = meanShift(X, radius, rate, maxIter, minCsize, blur )
 %  minCsize    - [] min cluster size (smaller clusters get eliminated)
 %  blur        - [] if blur then at each iter data is 'blurred', ie the
 %                original data points move (can cause 'incorrect' results)
+%  nThreads    - [16] max number of computational threads to use
+%  kernel      - ['flat'] kernel type, either 'flat' or 'gauss'
 %
 % OUTPUTS
 %  IDX         - cluster membership [see kmeans2.m]
@@ -51,14 +69,24 @@ if( nargin<3 ); rate =.2; end
 if( nargin<4 ); maxIter =100; end
 if( nargin<5 ); minCsize = 1; end
 if( nargin<6 ); blur =0; end
+if( nargin<7 ); nThreads =16; end
+if( nargin<8 || isempty(kernel) ); kernel ='flat'; end
 if( rate<=0 || rate>1 ); error('rate must be between 0 and 1'); end
 
 % OLD VERSION OF rate (gradient descent proportionality factor)
 % rate = rate * (size(X,2) + 2) / radius^2;
 
+% kernel (gamma>0 indicates Gaussian kernel exp(-gamma*dist^2))
+switch kernel
+  case 'flat', gamma=0;
+  case 'gauss', gamma=4.5/radius^2;
+  otherwise, error('unknown kernel: %s',kernel);
+end
+
 % c code does the work  (meanShift1 requires X')
-[IDX,meansFinal] = meanShift1(X',radius,rate,maxIter,blur);
-meansFinal = meansFinal';
+if( ~isa(X,'single') ); X=double(X); end
+[IDX,meansFinal] = meanShift1(X',radius,rate,maxIter,blur,gamma,nThreads);
+meansFinal = double(meansFinal');
 
 % calculate final cluster means per cluster
 p = size(X,2);  k = max(IDX);
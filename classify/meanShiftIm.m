@@ -1,4 +1,5 @@
-function [M,Vr,Vc] = meanShiftIm( X,sigSpt,sigRng,softFlag,maxIter,minDel )
+function [M,Vr,Vc] = meanShiftIm( X,sigSpt,sigRng,softFlag,maxIter,minDel,...
+  gridFlag,nThreads )
 % Applies the meanShift algorithm to a joint spatial/range image.
 %
 % See "Mean Shift Analysis and Applications" by Comaniciu & Meer for info.
@@ -22,6 +23,15 @@ function [M,Vr,Vc] = meanShiftIm( X,sigSpt,sigRng,softFlag,maxIter,minDel )
 % r.  The implementation remains efficient by actually using a hard cutoff
 % at points further then 2r spatially from x.
 %
+% The computation is done by a compiled routine that processes pixels in
+% parallel (using up to nThreads threads). If gridFlag==1 an approximate
+% and faster variant is used: pixels are grouped in a sparse bilateral grid
+% with spatial cells of sigSpt x sigSpt pixels and range cells of sigRng/2
+% in every channel. Each non-empty cell is replaced by its centroid,
+% weighted by the number of pixels it contains. The means are then computed
+% from the cells rather than the pixels within the spatial window. The
+% savings grow with sigSpt (and softFlag).
+%
 % The resulting matrix M is of size MxNx(P+2).  M(i,j,1) represents the
 % convergent row location of X(i,j,:) - (which had initial row location i)
 % and M(i,j,2) represents the final column location.  M(i,j,p+2) represents
@@ -31,7 +41,8 @@ function [M,Vr,Vc] = meanShiftIm( X,sigSpt,sigRng,softFlag,maxIter,minDel )
 % its convergent location.  Display using quiver(Vc,Vr,0).
 %
 % USAGE
-%  [M,Vr,Vc] = meanShiftIm( X,sigSpt,sigRng,[softFlag],[maxIter],[minDel] )
+%  [M,Vr,Vc] = meanShiftIm( X,sigSpt,sigRng,[softFlag],[maxIter],[minDel],...
+%    [gridFlag],[nThreads] )
 %
 % INPUTS
 %  X        - MxNxP data array, P may be 1
@@ -40,6 +51,8 @@ function [M,Vr,Vc] = meanShiftIm( X,sigSpt,sigRng,softFlag,maxIter,minDel )
 %  softFlag - [0]- see above
 %  maxIter  - [100] maximum number of iterations per data point
 %  minDel   - [.001] minimum amount of spatial change defining convergence
+%  gridFlag - [0] if 1 use approximate bilateral grid (see above)
+%  nThreads - [16] max number of computational threads to use
 %
 % OUTPUTS
 %  M        - array of convergent locations [see above]
@@ -54,6 +67,8 @@ function [M,Vr,Vc] = meanShiftIm( X,sigSpt,sigRng,softFlag,maxIter,minDel )
 %  I=double(imread('hestain.png'))/255;
 %  [M,Vr,Vc] = meanShiftIm( I,5,.2 );
 %  figure(1); im(I); figure(2); im( M(:,:,3:end) );
+%  % approximate but faster variant:
+%  M = meanShiftIm( I,5,.2,0,100,.001,1 );
 %
 % See also MEANSHIFT, MEANSHIFTIMEXPLORE
 %
@@ -65,52 +80,17 @@ function [M,Vr,Vc] = meanShiftIm( X,sigSpt,sigRng,softFlag,maxIter,minDel )
 if( nargin<4 || isempty(softFlag)); softFlag = 0; end
 if( nargin<5 || isempty(maxIter) ); maxIter = 100; end
 if( nargin<6 || isempty(minDel)); minDel = .001; end
+if( nargin<7 || isempty(gridFlag)); gridFlag = 0; end
+if( nargin<8 || isempty(nThreads)); nThreads = 16; end
 
-[mrows, ncols, p] = size(X); p = p+2;
-[gridRs, gridCs] = ndgrid( 1:mrows, 1:ncols );
-data = cat( 3, cat( 3, gridRs/sigSpt, gridCs/sigSpt), X/sigRng );
-
-%%% MAIN LOOP
-M = data;
-ticId = ticStatus('meanShiftIm');  %t0 = clock;  tlast = t0;
-if( softFlag ); radius = sigSpt*2; else radius = sigSpt; end
-for i=1:mrows; for j=1:ncols; %#ok<ALIGN>
-    Mij = data(i,j,:); Mij = Mij(:)';
-    itercount = 0; diff = 1;
-    while( itercount < maxIter && diff>minDel )
-
-      % get data which is possibly relevant (within spatial range)
-      r = round( Mij(1)*sigSpt );  c = round( Mij(2)*sigSpt );
-      boundsr = max(1,r-radius):min(mrows,r+radius);
-      boundsc = max(1,c-radius):min(ncols,c+radius);
-      dataWin = data( boundsr, boundsc, : );
-      dataWinF = reshape( dataWin, [], p );
-
-      % get next mean
-      MijOld = Mij;
-      n = size( dataWinF, 1);
-      D = sum( (dataWinF - ones(n,1)*Mij).^2, 2 );
-      if( softFlag )
-        S = exp( -D ); sumS = sum(S); Srep = S(:,ones(1,p));
-        Mij = sum( dataWinF .* Srep, 1 ) / sumS;
-      else
-        dataWinF = dataWinF( D < 1, : );
-        Mij = sum( dataWinF, 1 ) / size( dataWinF,1 );
-      end
-
-      % check if Mij changed [only on basis of x,y location]
-      diff = sum( (MijOld(1:2)-Mij(1:2)).^2 );
-      itercount = itercount+1;
-
-    end
-    M(i,j,:) = Mij(:);
-    fracdone = ((i-1)*ncols+j) / (mrows*ncols);
-    tocStatus( ticId, fracdone );
-  end
-end
+%%% MAIN LOOP (mean shift from every pixel)
+[mrows, ncols, ~] = size(X);
+M = meanShiftIm1( double(X), sigSpt, sigRng, softFlag, maxIter, minDel, ...
+  gridFlag, nThreads );
 M = cat(3, M(:,:,1:2)*sigSpt, M(:,:,3:end)*sigRng );
 
 %%% Output spatial difference
 if( nargout>1 )
+  [gridRs, gridCs] = ndgrid( 1:mrows, 1:ncols );
   Vr = M(:,:,1)-gridRs;  Vc = M(:,:,2)-gridCs;
 end
@@ -1,4 +1,4 @@
-function [U,mu,vars] = pca( X )
+function [U,mu,vars] = pca( X, nThreads )
 % Principal components analysis (alternative to princomp).
 %
 % A simple linear dimensionality reduction technique. Use to create an
@@ -23,11 +23,22 @@ function [U,mu,vars] = pca( X )
 % To calculate residuals:
 %  residuals = cumsum(vars/sum(vars)); plot(residuals,'-.')
 %
+% If the data does not fit in memory, X can instead be a function handle
+% that is called as X(i) for i=1,2,... and returns the i-th chunk of the
+% data ([d1 x ... x dm x ni], with ni>1 for the first chunk). It returns []
+% once all chunks have been returned. Chunks can be read from disk or
+% generated on the fly. The mean and the [dxd] covariance are accumulated
+% over all chunks (without sampling) using a compiled blocked kernel
+% running on up to nThreads threads. The principal components are then
+% obtained from the covariance, as in the in memory case for d<=n.
+%
 % USAGE
-%  [U,mu,vars] = pca( X )
+%  [U,mu,vars] = pca( X, [nThreads] )
 %
 % INPUTS
 %  X         - [d1 x ... x dm x n], treated as n [d1 x ... x dm] elements
+%              or function handle returning chunks of the data (see above)
+%  nThreads  - [16] max number of computational threads (streaming only)
 %
 % OUTPUTS
 %  U         - [d x r], d=prod(di), each column is a principal component
@@ -40,6 +51,9 @@ function [U,mu,vars] = pca( X )
 %  [Y,Xhat,avsq] = pcaApply( I3D1(:,:,1), U, mu, 5 );
 %  pcaVisualize( U, mu, vars, I3D1, 13, [0:12], [], 1 );
 %  Xr = pcaRandVec( U, mu, vars, 1, 25, 0, 3 );
+%  % streaming version (chunks of 10 observations)
+%  f = @(i) I3D1(:,:,(i-1)*10+1:min(i*10,end));
+%  [U1,mu1,vars1] = pca( f );
 %
 % See also princomp, pcaApply, pcaVisualize, pcaRandVec, visualizeData
 %
@@ -47,6 +61,10 @@ function [U,mu,vars] = pca( X )
 % Copyright 2014 Piotr Dollar.  [pdollar-at-gmail.com]
 % Licensed under the Simplified BSD License [see external/bsd.txt]
 
+% streaming version (accumulate over chunks)
+if( nargin<2 || isempty(nThreads) ), nThreads=16; end
+if( isa(X,'function_handle') ), [U,mu,vars]=pcaStream(X,nThreads); return; end
+
 % set X to be zero mean, then flatten
 d=size(X); n=d(end); d=prod(d(1:end-1));
 if(~isa(X,'double')), X=double(X); end
@@ -73,6 +91,24 @@ K=vars>1e-30; vars=vars(K); U=U(:,K);
 
 end
 
+function [U,mu,vars] = pcaStream( f, nThreads )
+% Accumulate sum and scatter of data chunks shifted by K (mean of the first
+% chunk, for numerical stability) then compute PCA from the covariance.
+X=f(1); if(isempty(X)), error('no data returned by X(1)'); end
+siz=size(X); d=prod(siz(1:end-1)); K=mean(reshape(double(X),d,[]),2);
+s=zeros(d,1); S=zeros(d); n=0; i=1;
+while( ~isempty(X) )
+  if(~isa(X,'single')), X=double(X); end; X=reshape(X,d,[]);
+  [s1,S1]=pcaCov1(X,K,nThreads); s=s+s1; S=S+S1; n=n+size(X,2);
+  i=i+1; X=f(i);
+end
+m=s/n; mu=reshape(K+m,[siz(1:end-1) 1]);
+if(n==1); U=zeros(d,1); vars=0; return; end
+C=(S-n*(m*m'))/(n-1); C=(C+C')/2;
+[~,SS,U]=robustSvd(C); vars=diag(SS);
+K=vars>1e-30; vars=vars(K); U=U(:,K);
+end
+
 function [U,S,V] = robustSvd( X, trials )
 % Robust version of SVD more likely to always converge.
 % [Converge issues only seem to appear on Matlab 2013a in Windows.]
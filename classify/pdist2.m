@@ -1,4 +1,4 @@
-function D = pdist2( X, Y, metric )
+function [D,IDS] = pdist2( X, Y, metric, k, nThreads )
 % Calculates the distance between sets of vectors.
 %
 % Let X be an m-by-p matrix representing m points in p-dimensional space
@@ -32,17 +32,31 @@ function D = pdist2( X, Y, metric )
 % 'L1'
 %   The L1 distance between two vectors is defined as:  sum(abs(x-y));
 %
+% The 'L1', 'emd' and 'chisq' distances are computed by a compiled engine
+% that processes X and Y in small blocks (using SSE for single inputs and
+% up to nThreads threads), so no [m x n x p] temporaries are created. The
+% full 'sqeuclidean', 'euclidean' and 'cosine' distances are computed using
+% matrix multiplication. If k>0, only the k nearest rows of Y to each row of
+% X are returned (for any metric, using the compiled engine), and the full
+% [m x n] matrix is never created. If either X or Y is single the engine
+% computes in single precision, otherwise in double. If the engine is not
+% compiled (see toolboxCompile) the full matrix is computed in Matlab (and
+% sorted if k>0), which is slower and uses more memory.
 %
 % USAGE
-%  D = pdist2( X, Y, [metric] )
+%  [D,IDS] = pdist2( X, Y, [metric], [k], [nThreads] )
 %
 % INPUTS
 %  X        - [m x p] matrix of m p-dimensional vectors
 %  Y        - [n x p] matrix of n p-dimensional vectors
 %  metric   - ['sqeuclidean'], 'chisq', 'cosine', 'emd', 'euclidean', 'L1'
+%  k        - [0] if k>0 return distances to k nearest rows of Y only
+%  nThreads - [16] max number of computational threads to use
 %
 % OUTPUTS
-%  D        - [m x n] distance matrix
+%  D        - [m x n] distance matrix (or [m x k] sorted distances if k>0)
+%  IDS      - [m x k] indices of the k nearest rows of Y (ties broken by
+%             lower index), empty if k==0
 %
 % EXAMPLE
 %  % simple example where points cluster well
@@ -54,6 +68,8 @@ function D = pdist2( X, Y, metric )
 %  tic, for i=1:r, D1 = pdist( X, 'euclidean' ); end, toc
 %  tic, for i=1:r, D2 = pdist2( X, X, 'euclidean' ); end, toc
 %  D1=squareform(D1); del=D1-D2; sum(abs(del(:)))
+%  % nearest neighbor search without computing full distance matrix
+%  X=rand(1000,20); Y=rand(20000,20); [D,IDS]=pdist2(X,Y,'L1',5);
 % 
 % See also pdist, distMatrixShow
 %
@@ -62,24 +78,30 @@ function D = pdist2( X, Y, metric )
 % Licensed under the Simplified BSD License [see external/bsd.txt]
 
 if( nargin<3 || isempty(metric) ); metric=0; end;
+if( nargin<4 || isempty(k) ); k=0; end;
+if( nargin<5 || isempty(nThreads) ); nThreads=16; end;
+metrics={'sqeuclidean','euclidean','L1','cosine','emd','chisq'};
+if(isequal(metric,0)), id=0; else id=find(strcmp(metric,metrics))-1; end
+if(isempty(id)), error(['pdist2 - unknown metric: ' metric]); end
 
-switch metric
-  case {0,'sqeuclidean'}
-    D = distEucSq( X, Y );
-  case 'euclidean'
-    D = sqrt(distEucSq( X, Y ));
-  case 'L1'
-    D = distL1( X, Y );
-  case 'cosine'
-    D = distCosine( X, Y );
-  case 'emd'
-    D = distEmd( X, Y );
-  case 'chisq'
-    D = distChiSq( X, Y );
-  otherwise
-    error(['pdist2 - unknown metric: ' metric]);
+useMex = exist('pdist2Mex','file')==3;
+if( (k==0 && any(id==[0 1 3])) || ~useMex )
+  switch id
+    case 0, D = distEucSq( X, Y );
+    case 1, D = sqrt(distEucSq( X, Y ));
+    case 2, D = distL1( X, Y );
+    case 3, D = distCosine( X, Y );
+    case 4, D = distEmd( X, Y );
+    case 5, D = distChiSq( X, Y );
+  end
+  D = max(0,D); IDS=[]; if(k<=0), return; end
+  [D,IDS] = sort(D,2); k=min(k,size(D,2)); D=D(:,1:k); IDS=IDS(:,1:k);
+  return;
 end
-D = max(0,D);
+if( isa(X,'single') || isa(Y,'single') )
+  X=single(full(X)); Y=single(full(Y)); else
+  X=double(full(X)); Y=double(full(Y)); end
+[D,IDS] = pdist2Mex( X, Y, id, k, nThreads );
 end
 
 function D = distL1( X, Y )
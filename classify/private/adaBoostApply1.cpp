@@ -0,0 +1,103 @@
+/*******************************************************************************
+* Piotr's Computer Vision Matlab Toolbox      Version 3.50
+* Copyright 2014 Piotr Dollar.  [pdollar-at-gmail.com]
+* Licensed under the Simplified BSD License [see external/bsd.txt]
+*******************************************************************************/
+#include <mex.h>
+#include <vector>
+#include "packBlocks.hpp"
+#ifdef USEOMP
+#include <omp.h>
+#endif
+
+typedef unsigned char uint8;
+#define min(x,y) ((x) < (y) ? (x) : (y))
+
+// Apply nWeak boosted trees (stored as [KxnWeak] arrays) as a soft cascade.
+// The trees are applied in order to blocks of samples, and as soon as the
+// score of a sample drops to or below thr it is removed from the block's
+// list of active samples (thr=-inf disables rejection). Scores are summed
+// in single precision (as adding the single hs in Matlab). Data is repacked
+// into row-major blocks (see packBlocks.hpp), and once all samples of a
+// block are rejected the remaining trees are skipped. Stores the (partial)
+// score of each sample in hs and the number of trees evaluated in trees.
+template<typename T>
+void adaBoostApply( const T *data, const T *thrs, const uint32 *fids,
+  const uint32 *child, const float *hs0, double thr, int N, int F, int K,
+  int nWeak, int nThreads, float *hs, double *trees )
+{
+  std::vector<uint32> fids1, used; int F1, B, nBlocks;
+  F1 = packFids(fids,child,size_t(K)*nWeak,F,fids1,used);
+  if( F1<0 ) mexErrMsgTxt("Feature ids out of range.");
+  B = packBlockSize(F1,sizeof(T)); nBlocks = (N+B-1)/B;
+  #ifdef USEOMP
+  nThreads = min(nThreads,omp_get_max_threads());
+  #pragma omp parallel num_threads(nThreads)
+  #endif
+  {
+    std::vector<T> buf(size_t(B)*F1+1); std::vector<int> active(B);
+    #ifdef USEOMP
+    #pragma omp for schedule(dynamic)
+    #endif
+    for( int b = 0; b < nBlocks; b++ ) {
+      int i0 = b*B, n = min(B,N-i0), nActive = n, i, j, t;
+      if( F1 ) packBlock(data,N,i0,n,&used[0],F1,&buf[0]);
+      for( i = 0; i < n; i++ ) { active[i]=i; hs[i0+i]=0; trees[i0+i]=nWeak; }
+      for( t = 0; t < nWeak && nActive; t++ ) {
+        size_t o = t*size_t(K); const T *thrs1 = thrs+o;
+        const uint32 *fids2 = &fids1[o], *child1 = child+o;
+        for( i = 0, j = 0; i < nActive; i++ ) {
+          int s = active[i]; const T *x = &buf[s*size_t(F1)]; uint32 k = 0;
+          while( child1[k] )
+            if( x[fids2[k]] < thrs1[k] )
+              k = child1[k]-1; else k = child1[k];
+          float h = hs[i0+s] += hs0[o+k];
+          if( h<=thr ) trees[i0+s]=t+1; else active[j++]=s;
+        }
+        nActive = j;
+      }
+    }
+  }
+}
+
+// [hs,trees]=mexFunction(data,thrs,fids,child,hs,thr,[nThreads])
+// thrs, fids, child and hs are the [KxnWeak] arrays of a model trained by
+// adaBoostTrain (hs must be single). Returns the [Nx1] single scores and the
+// number of trees evaluated for every sample (see adaBoostApply() above).
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+  int N, F, K, nWeak, nThreads; void *data, *thrs; uint32 *fids, *child;
+  float *hs0, *hs; double thr, *trees; mxClassID id;
+  if( nrhs<6 ) mexErrMsgTxt("At least six inputs required.");
+  data = mxGetData(prhs[0]);
+  thrs = mxGetData(prhs[1]);
+  fids = (uint32*) mxGetData(prhs[2]);
+  child = (uint32*) mxGetData(prhs[3]);
+  hs0 = (float*) mxGetData(prhs[4]);
+  thr = mxGetScalar(prhs[5]);
+  nThreads = (nrhs<7 || mxIsEmpty(prhs[6])) ? 100000
+    : (int) mxGetScalar(prhs[6]);
+  N = (int) mxGetM(prhs[0]);
+  F = (int) mxGetN(prhs[0]);
+  K = (int) mxGetM(prhs[1]);
+  nWeak = (int) mxGetN(prhs[1]);
+  id = mxGetClassID(prhs[0]);
+  if(id!=mxGetClassID(prhs[1]))
+    mexErrMsgTxt("Mismatch between data types.");
+  if(int(mxGetNumberOfElements(prhs[2]))!=K*nWeak ||
+    int(mxGetNumberOfElements(prhs[3]))!=K*nWeak ||
+    int(mxGetNumberOfElements(prhs[4]))!=K*nWeak )
+    mexErrMsgTxt("thrs, fids, child and hs must have same size.");
+  if(mxGetClassID(prhs[2])!=mxUINT32_CLASS ||
+    mxGetClassID(prhs[3])!=mxUINT32_CLASS || !mxIsSingle(prhs[4]))
+    mexErrMsgTxt("fids and child must be uint32 and hs single.");
+  plhs[0] = mxCreateNumericMatrix(N,1,mxSINGLE_CLASS,mxREAL);
+  plhs[1] = mxCreateNumericMatrix(N,1,mxDOUBLE_CLASS,mxREAL);
+  hs = (float*) mxGetData(plhs[0]); trees = (double*) mxGetData(plhs[1]);
+  #define APPLY(T) adaBoostApply((T*) data,(T*) thrs,fids,child,hs0,thr,\
+    N,F,K,nWeak,nThreads,hs,trees)
+  if(id==mxSINGLE_CLASS) APPLY(float);
+  else if(id==mxDOUBLE_CLASS) APPLY(double);
+  else if(id==mxUINT8_CLASS) APPLY(uint8);
+  else mexErrMsgTxt("Unknown data type.");
+  #undef APPLY
+}
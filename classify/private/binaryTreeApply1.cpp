@@ -0,0 +1,220 @@
+/*******************************************************************************
+* Piotr's Computer Vision Matlab Toolbox      Version 3.50
+* Copyright 2014 Piotr Dollar.  [pdollar-at-gmail.com]
+* Licensed under the Simplified BSD License [see external/bsd.txt]
+*******************************************************************************/
+#include <mex.h>
+#include <vector>
+#include <emmintrin.h>
+#ifdef USEOMP
+#include <omp.h>
+#endif
+
+typedef unsigned char uint8;
+typedef unsigned int uint32;
+#define min(x,y) ((x) < (y) ? (x) : (y))
+
+// samples are processed in groups of G (one SSE register of uint8 data)
+static const int G=16, MAXD=4;
+
+/*******************************************************************************
+* A tree of depth at most D is stored as a complete tree in heap order: node
+* p (0-indexed) has children 2p+1 and 2p+2 and leaf l is node l+2^D-1. Leaves
+* of the original tree above depth D are pushed down by inserting dummy
+* nodes whose children are both the same leaf. Every node goes to the right
+* child iff x[fid]>=thr (as in forestInds, nan goes right).
+*******************************************************************************/
+template<class T> struct HeapTree {
+  int D; std::vector<uint32> fids; std::vector<T> thrs;
+  std::vector<double> hs;
+
+  // depth of tree with K nodes, or maxD+1 if it exceeds maxD (children
+  // always follow their parent, so depths are set in a single pass)
+  static int depth( const uint32 *child, int K, int maxD ) {
+    std::vector<int> ds(K,0); int D=0;
+    for( int k=0; k<K; k++ ) if( child[k] ) {
+      int d=ds[k]+1; if( d>maxD ) return maxD+1;
+      ds[child[k]-1]=ds[child[k]]=d; if( d>D ) D=d;
+    }
+    return D;
+  }
+
+  // fill heap node p at depth d from node k of original tree
+  void fill( const T *thrs0, const uint32 *fids0, const uint32 *child,
+    const double *hs0, int p, uint32 k, int d )
+  {
+    if( d==D ) { hs[p-((1<<D)-1)]=hs0[k]; return; }
+    uint32 c0=k, c1=k; if( child[k] ) {
+      fids[p]=fids0[k]; thrs[p]=thrs0[k]; c0=child[k]-1; c1=child[k]; }
+    fill(thrs0,fids0,child,hs0,2*p+1,c0,d+1);
+    fill(thrs0,fids0,child,hs0,2*p+2,c1,d+1);
+  }
+
+  HeapTree( const T *thrs0, const uint32 *fids0, const uint32 *child,
+    const double *hs0, int D ) : D(D), fids((1<<D)-1,0),
+    thrs((1<<D)-1,T(0)), hs(1<<D) { fill(thrs0,fids0,child,hs0,0,0,0); }
+};
+
+// leaf reached by sample i of data [NxF] (scalar, any type)
+template<int D, class T> inline int leaf( const T *data, size_t N, size_t i,
+  const uint32 *fids, const T *thrs )
+{
+  int p=0; for( int d=0; d<D; d++ )
+    p=2*p+(data[fids[p]*N+i]<thrs[p] ? 1 : 2);
+  return p-((1<<D)-1);
+}
+
+// per node right child masks of G samples starting at i. For uint8 data one
+// SSE register holds all G samples (as 8 bit masks), for float data four
+// registers are used (as 32 bit masks). Masks of level d are combined by
+// selecting for every sample the mask of the node it currently occupies.
+inline __m128i goRight( const uint8 *x, uint8 t ) {
+  __m128i v=_mm_loadu_si128((const __m128i*) x);
+  return _mm_cmpeq_epi8(_mm_max_epu8(v,_mm_set1_epi8(char(t))),v);
+}
+
+template<int D> void leaves( const uint8 *data, size_t N, size_t i,
+  const uint32 *fids, const uint8 *thrs, uint8 *ls )
+{
+  __m128i p=_mm_setzero_si128(), one=_mm_set1_epi8(1), r, m; int d, j;
+  for( d=0; d<D; d++ ) {
+    int j0=(1<<d)-1; r=_mm_setzero_si128();
+    for( j=j0; j<2*j0+1; j++ ) {
+      m=goRight(data+fids[j]*N+i,thrs[j]);
+      if( d ) m=_mm_and_si128(m,_mm_cmpeq_epi8(p,_mm_set1_epi8(char(j))));
+      r=_mm_or_si128(r,m);
+    }
+    p=_mm_add_epi8(_mm_add_epi8(p,p),_mm_add_epi8(one,_mm_and_si128(r,one)));
+  }
+  p=_mm_sub_epi8(p,_mm_set1_epi8(char((1<<D)-1)));
+  _mm_storeu_si128((__m128i*) ls,p);
+}
+
+inline __m128i goRight( const float *x, float t ) {
+  return _mm_castps_si128(_mm_cmpnlt_ps(_mm_loadu_ps(x),_mm_set1_ps(t)));
+}
+
+template<int D> void leaves( const float *data, size_t N, size_t i,
+  const uint32 *fids, const float *thrs, uint8 *ls )
+{
+  for( int q=0; q<G; q+=4 ) {
+    __m128i p=_mm_setzero_si128(), one=_mm_set1_epi32(1), r; int d, j;
+    for( d=0; d<D; d++ ) {
+      int j0=(1<<d)-1; r=_mm_setzero_si128();
+      for( j=j0; j<2*j0+1; j++ ) {
+        __m128i m=goRight(data+fids[j]*N+i+q,thrs[j]);
+        if( d ) m=_mm_and_si128(m,_mm_cmpeq_epi32(p,_mm_set1_epi32(j)));
+        r=_mm_or_si128(r,m);
+      }
+      p=_mm_add_epi32(_mm_add_epi32(p,p),_mm_add_epi32(one,
+        _mm_and_si128(r,one)));
+    }
+    int l[4]; _mm_storeu_si128((__m128i*) l,p);
+    for( j=0; j<4; j++ ) ls[q+j]=uint8(l[j]-((1<<D)-1));
+  }
+}
+
+template<int D> void leaves( const double *data, size_t N, size_t i,
+  const uint32 *fids, const double *thrs, uint8 *ls )
+{
+  for( int j=0; j<G; j++ ) ls[j]=uint8(leaf<D>(data,N,i+j,fids,thrs));
+}
+
+// Apply tree of depth D to data [NxF] and store the leaf values in hs. Full
+// groups of G samples are evaluated branch free (every node of the tree is
+// tested for the whole group), the remaining samples one at a time.
+template<int D, class T, class O> void applyDepth( const T *data, int N,
+  const HeapTree<T> &tree, int nThreads, O *hs )
+{
+  const uint32 *fids=&tree.fids[0]; const T *thrs=&tree.thrs[0];
+  const double *hs0=&tree.hs[0]; int nG=N/G, g, j;
+  #ifdef USEOMP
+  #pragma omp parallel for num_threads(nThreads) schedule(static,64)
+  #endif
+  for( g=0; g<nG; g++ ) {
+    uint8 ls[G]; leaves<D>(data,N,size_t(g)*G,fids,thrs,ls);
+    for( int j1=0; j1<G; j1++ ) hs[g*G+j1]=O(hs0[ls[j1]]);
+  }
+  for( j=nG*G; j<N; j++ ) hs[j]=O(hs0[leaf<D>(data,N,j,fids,thrs)]);
+}
+
+// Apply tree of arbitrary depth (one sample at a time as in forestInds)
+template<class T, class O> void applyAny( const T *data, int N,
+  const T *thrs, const uint32 *fids, const uint32 *child, const double *hs0,
+  int nThreads, O *hs )
+{
+  #ifdef USEOMP
+  #pragma omp parallel for num_threads(nThreads) schedule(static,1024)
+  #endif
+  for( int i=0; i<N; i++ ) {
+    uint32 k=0; while( child[k] )
+      if( data[fids[k]*size_t(N)+i] < thrs[k] )
+        k=child[k]-1; else k=child[k];
+    hs[i]=O(hs0[k]);
+  }
+}
+
+// Apply tree, using a depth specialized evaluator if the depth is <=MAXD
+template<class T, class O> void apply( const T *data, int N, const T *thrs,
+  const uint32 *fids, const uint32 *child, const double *hs0, int K,
+  int nThreads, O *hs )
+{
+  int D=HeapTree<T>::depth(child,K,MAXD);
+  #ifdef USEOMP
+  nThreads = min(nThreads,omp_get_max_threads());
+  #endif
+  if( D>MAXD ) { applyAny(data,N,thrs,fids,child,hs0,nThreads,hs); return; }
+  HeapTree<T> tree(thrs,fids,child,hs0,D);
+  switch( D ) {
+    case 0: for( int i=0; i<N; i++ ) hs[i]=O(hs0[0]); break;
+    case 1: applyDepth<1>(data,N,tree,nThreads,hs); break;
+    case 2: applyDepth<2>(data,N,tree,nThreads,hs); break;
+    case 3: applyDepth<3>(data,N,tree,nThreads,hs); break;
+    case 4: applyDepth<4>(data,N,tree,nThreads,hs); break;
+  }
+}
+
+// hs=mexFunction(data,thrs,fids,child,hs,[nThreads])
+// Apply a single binary tree ([Kx1] thrs, fids, child and hs) to data [NxF]
+// (thrs must have the same type as data). Returns the [Nx1] leaf values hs
+// of the same type as the input hs (single or double).
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+  int N, F, K, nThreads; void *data, *thrs, *hs; uint32 *fids, *child;
+  mxClassID id, hid; std::vector<double> hs0;
+  if( nrhs<5 ) mexErrMsgTxt("At least five inputs required.");
+  data = mxGetData(prhs[0]);
+  thrs = mxGetData(prhs[1]);
+  fids = (uint32*) mxGetData(prhs[2]);
+  child = (uint32*) mxGetData(prhs[3]);
+  nThreads = (nrhs<6 || mxIsEmpty(prhs[5])) ? 100000
+    : (int) mxGetScalar(prhs[5]);
+  N = (int) mxGetM(prhs[0]);
+  F = (int) mxGetN(prhs[0]);
+  K = (int) mxGetNumberOfElements(prhs[1]);
+  id = mxGetClassID(prhs[0]); hid = mxGetClassID(prhs[4]);
+  if(id!=mxGetClassID(prhs[1]))
+    mexErrMsgTxt("Mismatch between data types.");
+  if(K<1 || int(mxGetNumberOfElements(prhs[2]))!=K ||
+    int(mxGetNumberOfElements(prhs[3]))!=K ||
+    int(mxGetNumberOfElements(prhs[4]))!=K )
+    mexErrMsgTxt("thrs, fids, child and hs must have same size.");
+  if(mxGetClassID(prhs[2])!=mxUINT32_CLASS ||
+    mxGetClassID(prhs[3])!=mxUINT32_CLASS)
+    mexErrMsgTxt("fids and child must be of type uint32.");
+  if(hid!=mxSINGLE_CLASS && hid!=mxDOUBLE_CLASS)
+    mexErrMsgTxt("hs must be of type single or double.");
+  for( int k=0; k<K; k++ ) if( child[k] && (child[k]<=uint32(k)+1
+    || child[k]>=uint32(K) || fids[k]>=uint32(F)) )
+    mexErrMsgTxt("Invalid tree.");
+  hs0.resize(K); for( int k=0; k<K; k++ ) hs0[k] = hid==mxSINGLE_CLASS ?
+    ((float*) mxGetData(prhs[4]))[k] : mxGetPr(prhs[4])[k];
+  plhs[0] = mxCreateNumericMatrix(N,1,hid,mxREAL); hs = mxGetData(plhs[0]);
+  #define APPLY(T) if( hid==mxSINGLE_CLASS ) apply((T*) data,N,(T*) thrs,\
+    fids,child,&hs0[0],K,nThreads,(float*) hs); else apply((T*) data,N,\
+    (T*) thrs,fids,child,&hs0[0],K,nThreads,(double*) hs);
+  if(id==mxSINGLE_CLASS) { APPLY(float); }
+  else if(id==mxDOUBLE_CLASS) { APPLY(double); }
+  else if(id==mxUINT8_CLASS) { APPLY(uint8); }
+  else mexErrMsgTxt("Unknown data type.");
+  #undef APPLY
+}
@@ -12,23 +12,46 @@ typedef unsigned char uint8;
 typedef unsigned int uint32;
 #define min(x,y) ((x) < (y) ? (x) : (y))
 
-// construct cdf given data vector and wts
-void constructCdf( uint8* data, float *wts, int nBins,
-                  int N, int M, uint32 *ord, float *cdf )
+// construct histogram given data vector and wts
+template<class T> void constructHist( uint8* data, float *wts, int N, int M,
+  bool useOrd, uint32 *ord, T *hist )
 {
-  int i; for( i=0; i<nBins; i++) cdf[i]=0;
-  if(M) for( i=0; i<M; i++) cdf[data[ord[i]]] += wts[i];
-  else for( i=0; i<N; i++) cdf[data[i]] += wts[i];
-  for(i=1; i<nBins; i++) cdf[i]+=cdf[i-1];
+  int i; for( i=0; i<256; i++) hist[i]=0;
+  if(useOrd) for( i=0; i<M; i++) hist[data[ord[i]]] += wts[i];
+  else for( i=0; i<N; i++) hist[data[i]] += wts[i];
 }
 
-// [errs,thrs] = mexFunction( data0, data1, wts0, wts1,
-//  nBins, prior, fids, nThreads, [ord0], [ord1] )
+// find lowest error threshold given (normalized) class cdfs
+template<class T> void findThr( T *cdf0, T *cdf1, int nBins, float prior,
+  float &err, uint8 &thr )
+{
+  float e0, e1, e; int i, t=0;
+  if(prior<.5) { e0=prior; e1=1-prior; } else { e0=1-prior; e1=prior; }
+  for( i=0; i<nBins; i++) {
+    e = prior - cdf1[i] + cdf0[i];
+    if(e<e0) { e0=e; e1=1-e; t=i; } else if(e>e1) { e0=1-e; e1=e; t=i; }
+  }
+  err=e0; thr=(uint8) t;
+}
+
+// [errs,thrs,hist0,hist1,histS0,histS1] = mexFunction( data0, data1, wts0,
+//  wts1, nBins, prior, fids, nThreads, [ord0], [ord1], [hist0], [hist1] )
+// If ord is given only the data indexed by ord is used (wts must be aligned
+// with ord, i.e. wts0(i) is the weight of data0(ord0(i)+1,:)), otherwise all
+// data is used. An empty uint32 ord selects no data (an empty node), only a
+// missing or empty non-uint32 ord selects all data. Given histograms are not
+// recomputed unless ord is also given, in which case the given histograms
+// are the parent's and ord indexes the samples of one child (ideally the
+// smaller one). The child's histograms are built and output in hist0 and
+// hist1, and the sibling's (parent minus child) in histS0 and histS1. Errors
+// found using histograms are normalized by the total weight of the
+// histograms.
 void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
 {
   // get inputs
   int nBins, nThreads, N0, N1, M0, M1, F; float prior, *wts0, *wts1;
-  uint8 *data0, *data1; uint32 *fids, *ord0, *ord1;
+  uint8 *data0, *data1; uint32 *fids, *ord0, *ord1; double *hs0, *hs1;
+  bool useOrd;
   data0 = (uint8*) mxGetData(prhs[0]);
   data1 = (uint8*) mxGetData(prhs[1]);
   wts0 = (float*) mxGetData(prhs[2]);
@@ -40,13 +63,31 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
   N0 = (int) mxGetM(prhs[0]);
   N1 = (int) mxGetM(prhs[1]);
   F = (int) mxGetNumberOfElements(prhs[6]);
+  if( nBins<1 || nBins>256 ) mexErrMsgTxt("nBins must be in [1,256].");
 
-  // ord0 and ord1 are optional
-  if( nrhs<10 ) M0=M1=0; else {
+  // ord0 and ord1 are optional (if not given or [] all data is used, but an
+  // empty uint32 ord is an empty node and must never fall back to all data)
+  ord0=ord1=NULL; M0=M1=0; useOrd=nrhs>=10 && mxIsUint32(prhs[8]);
+  if( nrhs>=10 && !useOrd && !mxIsEmpty(prhs[8]) )
+    mexErrMsgTxt("ord0 and ord1 must be of type uint32.");
+  if( useOrd ) {
     ord0 = (uint32*) mxGetData(prhs[8]);
     ord1 = (uint32*) mxGetData(prhs[9]);
     M0 = (int) mxGetNumberOfElements(prhs[8]);
     M1 = (int) mxGetNumberOfElements(prhs[9]);
+    if( !mxIsUint32(prhs[9]) ) M1=-1;
+    for( int i=0; i<M0; i++ ) if( ord0[i]>=uint32(N0) ) M0=-1;
+    for( int i=0; i<M1; i++ ) if( ord1[i]>=uint32(N1) ) M1=-1;
+    if( M0<0 || M1<0 ) mexErrMsgTxt("ord0 or ord1 invalid.");
+  }
+
+  // hist0 and hist1 are optional [nBinsxF] precomputed histograms
+  hs0=hs1=NULL; if( nrhs>=12 && !mxIsEmpty(prhs[10]) ) {
+    if( !mxIsDouble(prhs[10]) || !mxIsDouble(prhs[11]) ||
+      mxGetNumberOfElements(prhs[10])!=size_t(nBins)*F ||
+      mxGetNumberOfElements(prhs[11])!=size_t(nBins)*F )
+      mexErrMsgTxt("hist0 and hist1 must be double [nBinsxF].");
+    hs0 = mxGetPr(prhs[10]); hs1 = mxGetPr(prhs[11]);
   }
 
   // create output structure
@@ -54,6 +95,17 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
   plhs[1] = mxCreateNumericMatrix(1,F,mxUINT8_CLASS,mxREAL);
   float *errs = (float*) mxGetData(plhs[0]);
   uint8 *thrs = (uint8*) mxGetData(plhs[1]);
+  double *hsOut0=NULL, *hsOut1=NULL; if( nlhs>2 ) {
+    plhs[2] = mxCreateNumericMatrix(nBins,F,mxDOUBLE_CLASS,mxREAL);
+    plhs[3] = mxCreateNumericMatrix(nBins,F,mxDOUBLE_CLASS,mxREAL);
+    hsOut0 = mxGetPr(plhs[2]); hsOut1 = mxGetPr(plhs[3]);
+  }
+  double *hsSib0=NULL, *hsSib1=NULL; if( nlhs>4 ) {
+    if( !hs0 || !useOrd ) mexErrMsgTxt("histS requires hist and ord.");
+    plhs[4] = mxCreateNumericMatrix(nBins,F,mxDOUBLE_CLASS,mxREAL);
+    plhs[5] = mxCreateNumericMatrix(nBins,F,mxDOUBLE_CLASS,mxREAL);
+    hsSib0 = mxGetPr(plhs[4]); hsSib1 = mxGetPr(plhs[5]);
+  }
 
   // find lowest error for each feature
   #ifdef USEOMP
@@ -61,14 +113,31 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
   #pragma omp parallel for num_threads(nThreads)
   #endif
   for( int f=0; f<F; f++ ) {
-    float cdf0[256], cdf1[256], e0, e1, e; int thr=0;
-    if(prior<.5) { e0=prior; e1=1-prior; } else { e0=1-prior; e1=prior; }
-    constructCdf(data0+N0*size_t(fids[f]),wts0,nBins,N0,M0,ord0,cdf0);
-    constructCdf(data1+N1*size_t(fids[f]),wts1,nBins,N1,M1,ord1,cdf1);
-    for( int i=0; i<nBins; i++) {
-      e = prior - cdf1[i] + cdf0[i];
-      if(e<e0) { e0=e; e1=1-e; thr=i; } else if(e>e1) { e0=1-e; e1=e; thr=i; }
+    int i; size_t o=f*size_t(nBins);
+    if( !hs0 && !hsOut0 ) {
+      // single precision cdfs of normalized weights
+      float cdf0[256], cdf1[256];
+      constructHist(data0+N0*size_t(fids[f]),wts0,N0,M0,useOrd,ord0,cdf0);
+      constructHist(data1+N1*size_t(fids[f]),wts1,N1,M1,useOrd,ord1,cdf1);
+      for( i=1; i<nBins; i++ ) { cdf0[i]+=cdf0[i-1]; cdf1[i]+=cdf1[i-1]; }
+      findThr(cdf0,cdf1,nBins,prior,errs[f],thrs[f]); continue;
+    }
+    // double precision histograms (given or computed and output)
+    double cdf0[256], cdf1[256], w;
+    if( hs0 && !useOrd ) for( i=0; i<nBins; i++ ) {
+      cdf0[i]=hs0[i+o]; cdf1[i]=hs1[i+o]; }
+    else {
+      constructHist(data0+N0*size_t(fids[f]),wts0,N0,M0,useOrd,ord0,cdf0);
+      constructHist(data1+N1*size_t(fids[f]),wts1,N1,M1,useOrd,ord1,cdf1);
     }
-    errs[f]=e0; thrs[f]=(uint8) thr;
+    if( hsOut0 ) for( i=0; i<nBins; i++ ) {
+      hsOut0[i+o]=cdf0[i]; hsOut1[i+o]=cdf1[i]; }
+    if( hsSib0 ) for( i=0; i<nBins; i++ ) {
+      hsSib0[i+o]=hs0[i+o]-cdf0[i]; hsSib1[i+o]=hs1[i+o]-cdf1[i]; }
+    for( i=1; i<nBins; i++ ) { cdf0[i]+=cdf0[i-1]; cdf1[i]+=cdf1[i-1]; }
+    // histograms need not be normalized, divide by total weight
+    w=cdf0[nBins-1]+cdf1[nBins-1]; if( w<=0 ) w=1;
+    for( i=0; i<nBins; i++ ) { cdf0[i]/=w; cdf1[i]/=w; }
+    findThr(cdf0,cdf1,nBins,prior,errs[f],thrs[f]);
   }
 }
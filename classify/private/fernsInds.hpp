@@ -0,0 +1,48 @@
+/*******************************************************************************
+* Piotr's Computer Vision Matlab Toolbox      Version 3.50
+* Copyright 2014 Piotr Dollar.  [pdollar-at-gmail.com]
+* Licensed under the Simplified BSD License [see external/bsd.txt]
+*******************************************************************************/
+#ifndef _FERNSINDS_HPP_
+#define _FERNSINDS_HPP_
+#include <stddef.h>
+#include <math.h>
+
+typedef unsigned char uint8;
+typedef unsigned int uint32;
+
+// number of samples for which fern inds are computed at once
+#define FERN_BLOCK 512
+
+// convert double thr to type C s.t. x<thr iff x<cvtThr(thr) for x of type T
+inline double cvtThr( double thr, double ) { return thr; }
+inline float cvtThr( double thr, float ) {
+  float t=(float) thr; if( double(t)<thr ) t=nextafterf(t,INFINITY);
+  return t;
+}
+inline int cvtThr( double thr, uint8 ) {
+  if( thr!=thr ) return 0; // x<nan is always false (as is x<0)
+  return thr<=0 ? 0 : (thr>256 ? 256 : (int) ceil(thr));
+}
+
+// Compute inds (plus offset off) of N samples for a single fern of depth S.
+// The (1-indexed) fid and thr at depth s are stored at fids[s*stride] and
+// thrs[s*stride]. The S bits of a block of samples are accumulated in a
+// small buffer while streaming over the S data columns (which vectorizes).
+template<class T, class C>
+void fernInds( const T *data, int N, const uint32 *fids, const double *thrs,
+  int S, size_t stride, uint32 off, uint32 *inds )
+{
+  uint32 ind[FERN_BLOCK]; C t; const T *d; int i, n, s;
+  for( int i0=0; i0<N; i0+=FERN_BLOCK ) {
+    n = (N-i0<FERN_BLOCK) ? N-i0 : FERN_BLOCK;
+    for( i=0; i<n; i++ ) ind[i]=0;
+    for( s=0; s<S; s++ ) {
+      d=data+(fids[s*stride]-1)*size_t(N)+i0; t=cvtThr(thrs[s*stride],T());
+      for( i=0; i<n; i++ ) ind[i]=(ind[i]<<1) | uint32(d[i]<t);
+    }
+    for( i=0; i<n; i++ ) inds[i0+i]=ind[i]+off;
+  }
+}
+
+#endif
@@ -0,0 +1,64 @@
+/*******************************************************************************
+* Piotr's Computer Vision Matlab Toolbox      Version 3.50
+* Copyright 2014 Piotr Dollar.  [pdollar-at-gmail.com]
+* Licensed under the Simplified BSD License [see external/bsd.txt]
+*******************************************************************************/
+#include "mex.h"
+#include "fernsInds.hpp"
+#ifdef USEOMP
+#include <omp.h>
+#endif
+
+#define min(x,y) ((x) < (y) ? (x) : (y))
+
+// compute fern inds (ferns are processed in parallel)
+template<class T, class C>
+void fernsInds( const T *data, const uint32 *fids, const double *thrs,
+  int N, int M, int S, uint32 *inds, int nThreads )
+{
+  #ifdef USEOMP
+  nThreads = min(nThreads,omp_get_max_threads());
+  #pragma omp parallel for num_threads(nThreads) schedule(dynamic)
+  #endif
+  for( int m=0; m<M; m++ )
+    fernInds<T,C>(data,N,fids+m,thrs+m,S,M,1,inds+m*size_t(N));
+}
+
+// inds = mexFunction( data, fids, thrs, [nThreads] )
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+  int N, F, M, S, nThreads, i; void *data; double *thrs;
+  uint32 *fids, *inds; mxClassID id;
+
+  /* Error checking on arguments */
+  if( nrhs<3 || nrhs>4 ) mexErrMsgTxt("Three or four inputs required.");
+  if( nlhs>1 ) mexErrMsgTxt("Too many output arguments.");
+  if( !mxIsClass(prhs[1], "uint32") || !mxIsClass(prhs[2], "double"))
+    mexErrMsgTxt("Input arrays are of incorrect type.");
+
+  /* extract inputs */
+  data = mxGetData(prhs[0]); /* N x F */
+  fids = (uint32*) mxGetData(prhs[1]); /* M x S */
+  thrs = (double*) mxGetData(prhs[2]); /* M x S */
+  nThreads = (nrhs<4) ? 100000 : (int) mxGetScalar(prhs[3]);
+  N=(int) mxGetM(prhs[0]); F=(int) mxGetN(prhs[0]);
+  M=(int) mxGetM(prhs[1]); S=(int) mxGetN(prhs[1]);
+  id=mxGetClassID(prhs[0]);
+  if( S>32 ) mexErrMsgTxt("Fern depth S must be at most 32.");
+  if( mxGetNumberOfElements(prhs[2])!=size_t(M)*S )
+    mexErrMsgTxt("fids and thrs must have same size.");
+  for( i=0; i<M*S; i++ ) if( fids[i]<1 || fids[i]>uint32(F) )
+    mexErrMsgTxt("Feature ids out of range.");
+
+  /* create outputs */
+  plhs[0] = mxCreateNumericMatrix(N, M, mxUINT32_CLASS, mxREAL);
+  inds = (uint32*) mxGetData(plhs[0]); /* N x M */
+
+  /* compute inds */
+  if( id==mxDOUBLE_CLASS )
+    fernsInds<double,double>((double*)data,fids,thrs,N,M,S,inds,nThreads);
+  else if( id==mxSINGLE_CLASS )
+    fernsInds<float,float>((float*)data,fids,thrs,N,M,S,inds,nThreads);
+  else if( id==mxUINT8_CLASS )
+    fernsInds<uint8,int>((uint8*)data,fids,thrs,N,M,S,inds,nThreads);
+  else mexErrMsgTxt("Input arrays are of incorrect type.");
+}
@@ -0,0 +1,167 @@
+/*******************************************************************************
+* Piotr's Computer Vision Matlab Toolbox      Version 3.50
+* Copyright 2014 Piotr Dollar.  [pdollar-at-gmail.com]
+* Licensed under the Simplified BSD License [see external/bsd.txt]
+*******************************************************************************/
+#include "mex.h"
+#include <float.h>
+#include <vector>
+#include <algorithm>
+#include "fernsInds.hpp"
+#ifdef USEOMP
+#include <omp.h>
+#endif
+
+typedef std::pair<double,double> dpair;
+
+// sort comparator placing nans last
+inline bool nanLess( const dpair &a, const dpair &b ) {
+  return a.first<b.first || (a.first==a.first && b.first!=b.first);
+}
+
+// train single fern regressor given inds (sets ysFern)
+void trainFern( const double *ys, const uint32 *inds, int N, int K,
+  double reg, double *ysFern )
+{
+  std::vector<double> cnts(K,0.0); double mu=0; int n, k;
+  for( n=0; n<N; n++ ) mu+=ys[n];
+  mu/=N;
+  for( k=0; k<K; k++ ) ysFern[k]=0;
+  for( n=0; n<N; n++ ) { ysFern[inds[n]]+=ys[n]-mu; cnts[inds[n]]++; }
+  for( k=0; k<K; k++ )
+    ysFern[k]=ysFern[k]/std::max(cnts[k]+reg*N,DBL_EPSILON)+mu;
+}
+
+// weighted median of x (xw is a buffer containing (x,w) pairs)
+double medianw( std::vector<dpair> &xw ) {
+  std::sort(xw.begin(),xw.end(),nanLess); double w=0, c=0; size_t i;
+  for( i=0; i<xw.size(); i++ ) w+=xw[i].second;
+  for( i=0; i<xw.size(); i++ ) { c+=xw[i].second; if(c>=w/2) break; }
+  return xw[i<xw.size() ? i : 0].first;
+}
+
+// Boosted regression using random ferns (see fernsRegTrain.m). The R random
+// ferns of every phase are trained and evaluated in parallel.
+template<class T, class C>
+void fernsRegTrain( const T *data, const double *ys, int N,
+  const uint32 *fidsR, const double *thrsR, int M, int R, int S, int type,
+  int loss, double reg, double eta, int verbose, int nThreads,
+  uint32 *fids, double *thrs, double *ysFern, double *ysSum )
+{
+  int K=1<<S, m, n, r, s, k; double d, e, aBst=1;
+  std::vector<double> ysTar(N), tar(N), ysFernR(size_t(R)*K), es(R), as(R);
+  std::vector<uint32> inds(size_t(R)*N);
+  #ifdef USEOMP
+  nThreads = std::min(nThreads,omp_get_max_threads());
+  #endif
+  for( m=0; m<M; m++ ) {
+    // compute current target and error (and fern target based on loss)
+    d = (type==1) ? m+1 : 1; e=0;
+    for( n=0; n<N; n++ ) {
+      double y=ysTar[n]=d*ys[n]-ysSum[n];
+      if( loss==0 ) { tar[n]=(y>0)-(y<0); e+=fabs(y); }
+      else if( loss==1 ) { tar[n]=y; e+=y*y; }
+      else { tar[n]=exp(y/d)-exp(-y/d); e+=exp(y/d)+exp(-y/d); }
+    }
+    // train R random ferns and compute their error (in parallel)
+    #ifdef USEOMP
+    #pragma omp parallel num_threads(std::min(nThreads,R))
+    #endif
+    {
+      std::vector<dpair> xw(loss==0 ? N : 0);
+      #ifdef USEOMP
+      #pragma omp for schedule(dynamic)
+      #endif
+      for( r=0; r<R; r++ ) {
+        size_t j=size_t(m)*R+r; uint32 *ind=&inds[size_t(r)*N];
+        double *yf=&ysFernR[size_t(r)*K], a=1, e1=0; int i;
+        fernInds<T,C>(data,N,fidsR+j,thrsR+j,S,size_t(M)*R,0,ind);
+        trainFern(&tar[0],ind,N,K,reg,yf);
+        if( loss==0 ) {
+          for( i=0; i<N; i++ ) { double y1=yf[ind[i]];
+            xw[i]=dpair(ysTar[i]/y1,fabs(y1)); }
+          a=medianw(xw);
+          for( i=0; i<N; i++ ) e1+=fabs(ysTar[i]-a*yf[ind[i]]);
+        } else if( loss==1 ) {
+          for( i=0; i<N; i++ ) { double y=ysTar[i]-yf[ind[i]]; e1+=y*y; }
+        } else {
+          // line search for best scaling (starting range based on aBst)
+          double aMin=aBst/5, aMax=aBst*5, aDel; e1=INFINITY; a=aBst;
+          for( int phase=0; phase<3; phase++ ) {
+            aDel=(aMax-aMin)/10;
+            for( int l=0; l<=10; l++ ) {
+              double a1=aMin+l*aDel, eTmp=0; for( i=0; i<N; i++ ) {
+                double y=(ysTar[i]-a1*yf[ind[i]])/d; eTmp+=exp(y)+exp(-y); }
+              if( eTmp<e1 ) { a=a1; e1=eTmp; }
+            }
+            aMin=a-aDel; aMax=a+aDel;
+          }
+        }
+        for( i=0; i<K; i++ ) yf[i]*=a;
+        es[r]=e1; as[r]=a;
+      }
+    }
+    // keep best fern (later ferns win ties), store results and update sums
+    int best=-1; for( r=0; r<R; r++ ) if( es[r]<=e ) { e=es[r]; best=r; }
+    if( best<0 ) mexErrMsgTxt("No fern reduced the error.");
+    size_t j=size_t(m)*R+best; const uint32 *ind=&inds[size_t(best)*N];
+    const double *yf=&ysFernR[size_t(best)*K]; if( loss==2 ) aBst=as[best];
+    for( s=0; s<S; s++ ) { fids[m+s*M]=fidsR[j+s*size_t(M)*R];
+      thrs[m+s*M]=thrsR[j+s*size_t(M)*R]; }
+    for( k=0; k<K; k++ ) ysFern[k+size_t(m)*K]=yf[k]*eta;
+    for( n=0; n<N; n++ ) ysSum[n]+=yf[ind[n]]*eta;
+    if( verbose ) mexPrintf("phase=%i  error=%f\n",m+1,e);
+  }
+}
+
+// [fids,thrs,ysFern,ysSum] = mexFunction( data, ys, fidsR, thrsR, M, type,
+//   loss, reg, eta, verbose, nThreads )
+// fidsR and thrsR are [M*RxS] (1-indexed) random fern proposals (the R
+// proposals of phase m are stored in rows (m-1)*R+1:m*R), type is 0 ('res')
+// or 1 ('ave') and loss is 0 ('L1'), 1 ('L2') or 2 ('exp').
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+  int N, F, M, R, S, type, loss, verbose, nThreads, i; void *data;
+  double *ys, *thrsR, reg, eta; uint32 *fidsR; mxClassID id;
+  if( nrhs!=11 ) mexErrMsgTxt("Eleven input arguments required.");
+  data = mxGetData(prhs[0]);
+  ys = (double*) mxGetData(prhs[1]);
+  fidsR = (uint32*) mxGetData(prhs[2]);
+  thrsR = (double*) mxGetData(prhs[3]);
+  M = (int) mxGetScalar(prhs[4]);
+  type = (int) mxGetScalar(prhs[5]);
+  loss = (int) mxGetScalar(prhs[6]);
+  reg = mxGetScalar(prhs[7]);
+  eta = mxGetScalar(prhs[8]);
+  verbose = (int) mxGetScalar(prhs[9]);
+  nThreads = (int) mxGetScalar(prhs[10]);
+  N = (int) mxGetM(prhs[0]); F = (int) mxGetN(prhs[0]);
+  S = (int) mxGetN(prhs[2]); R = M ? (int) mxGetM(prhs[2])/M : 0;
+  id = mxGetClassID(prhs[0]);
+  if( !mxIsClass(prhs[1],"double") || !mxIsClass(prhs[2],"uint32") ||
+    !mxIsClass(prhs[3],"double") || int(mxGetNumberOfElements(prhs[1]))!=N )
+    mexErrMsgTxt("Input arrays are of incorrect type or size.");
+  if( S<1 || S>24 || R<1 || int(mxGetM(prhs[2]))!=M*R ||
+    mxGetNumberOfElements(prhs[3])!=mxGetNumberOfElements(prhs[2]) )
+    mexErrMsgTxt("Invalid fern proposals.");
+  for( i=0; i<M*R*S; i++ ) if( fidsR[i]<1 || fidsR[i]>uint32(F) )
+    mexErrMsgTxt("Feature ids out of range.");
+
+  // create outputs
+  plhs[0] = mxCreateNumericMatrix(M,S,mxUINT32_CLASS,mxREAL);
+  plhs[1] = mxCreateNumericMatrix(M,S,mxDOUBLE_CLASS,mxREAL);
+  plhs[2] = mxCreateNumericMatrix(1<<S,M,mxDOUBLE_CLASS,mxREAL);
+  plhs[3] = mxCreateNumericMatrix(N,1,mxDOUBLE_CLASS,mxREAL);
+  uint32 *fids = (uint32*) mxGetData(plhs[0]);
+  double *thrs=mxGetPr(plhs[1]), *ysFern=mxGetPr(plhs[2]);
+  double *ysSum=mxGetPr(plhs[3]);
+
+  // train boosted ferns
+  #define TRAIN(T,C) fernsRegTrain<T,C>((T*)data,ys,N,fidsR,thrsR,M,R,S,\
+    type,loss,reg,eta,verbose,nThreads,fids,thrs,ysFern,ysSum)
+  if( id==mxDOUBLE_CLASS ) TRAIN(double,double);
+  else if( id==mxSINGLE_CLASS ) TRAIN(float,float);
+  else if( id==mxUINT8_CLASS ) TRAIN(uint8,int);
+  else mexErrMsgTxt("Input arrays are of incorrect type.");
+  #undef TRAIN
+}
@@ -3,83 +3,76 @@
 * Copyright 2014 Piotr Dollar.  [pdollar-at-gmail.com]
 * Licensed under the Simplified BSD License [see external/bsd.txt]
 *******************************************************************************/
-#include <string.h>
-#include <stdint.h>
-#include <math.h>
 #include <mex.h>
+#include "forestFindThr.hpp"
+#ifdef USEOMP
+#include <omp.h>
+#endif
 
-typedef unsigned int uint32;
-#define gini(p) p*p
-#define entropy(p) (-p*flog2(float(p)))
+#define min(x,y) ((x) < (y) ? (x) : (y))
 
-// fast approximate log2(x) from Paul Mineiro <paul@mineiro.com>
-inline float flog2( float x ) {
-  union { float f; uint32_t i; } vx = { x };
-  union { uint32_t i; float f; } mx = { (vx.i & 0x007FFFFF) | 0x3f000000 };
-  float y = float(vx.i); y *= 1.1920928955078125e-7f;
-  return y - 124.22551499f - 1.498030302f * mx.f
-    - 1.72587999f / (0.3520887068f + mx.f);
-}
-
-// perform actual computation
+// perform actual computation (data or quantized data dataQ must be given)
 void forestFindThr( int H, int N, int F, const float *data,
-  const uint32 *hs, const float *ws, const uint32 *order, const int split,
-  uint32 &fid, float &thr, double &gain )
+  const uint8 *dataQ, const uint32 *hs, const float *ws,
+  const uint32 *order, const float *edges, const int E, const int split,
+  int nThreads, uint32 &fid, float &thr, double &gain )
 {
-  double *Wl, *Wr, *W; float *data1; uint32 *order1;
-  int i, j, j1, j2, h; double vBst, vInit, v, w, wl, wr, g, gl, gr;
-  Wl=new double[H]; Wr=new double[H]; W=new double[H];
+  double *W, *vs; float *ts; int i; double vBst, vInit, w, g;
+  W=new double[H]; vs=new double[F]; ts=new float[F];
   // perform initialization
-  vBst = vInit = 0; g = 0; w = 0; fid = 1; thr = 0;
-  for( i=0; i<H; i++ ) W[i] = 0;
-  for( j=0; j<N; j++ ) { w+=ws[j]; W[hs[j]-1]+=ws[j]; }
-  if( split==0 ) { for( i=0; i<H; i++ ) g+=gini(W[i]); vBst=vInit=(1-g/w/w); }
-  if( split==1 ) { for( i=0; i<H; i++ ) g+=entropy(W[i]); vBst=vInit=g/w; }
-  // loop over features, then thresholds (data is sorted by feature value)
-  for( i=0; i<F; i++ ) {
-    order1=(uint32*) order+i*N; data1=(float*) data+i*size_t(N);
-    for( j=0; j<H; j++ ) { Wl[j]=0; Wr[j]=W[j]; } gl=wl=0; gr=g; wr=w;
-    for( j=0; j<N-1; j++ ) {
-      j1=order1[j]; j2=order1[j+1]; h=hs[j1]-1;
-      if(split==0) {
-        // gini = 1-\sum_h p_h^2; v = gini_l*pl + gini_r*pr
-        wl+=ws[j1]; gl-=gini(Wl[h]); Wl[h]+=ws[j1]; gl+=gini(Wl[h]);
-        wr-=ws[j1]; gr-=gini(Wr[h]); Wr[h]-=ws[j1]; gr+=gini(Wr[h]);
-        v = (wl-gl/wl)/w + (wr-gr/wr)/w;
-      } else if (split==1) {
-        // entropy = -\sum_h p_h log(p_h); v = entropy_l*pl + entropy_r*pr
-        gl+=entropy(wl); wl+=ws[j1]; gl-=entropy(wl);
-        gr+=entropy(wr); wr-=ws[j1]; gr-=entropy(wr);
-        gl-=entropy(Wl[h]); Wl[h]+=ws[j1]; gl+=entropy(Wl[h]);
-        gr-=entropy(Wr[h]); Wr[h]-=ws[j1]; gr+=entropy(Wr[h]);
-        v = gl/w + gr/w;
-      } else if (split==2) {
-        // twoing: v = pl*pr*\sum_h(|p_h_left - p_h_right|)^2 [slow if H>>0]
-        j1=order1[j]; j2=order1[j+1]; h=hs[j1]-1;
-        wl+=ws[j1]; Wl[h]+=ws[j1]; wr-=ws[j1]; Wr[h]-=ws[j1];
-        g=0; for( int h1=0; h1<H; h1++ ) g+=fabs(Wl[h1]/wl-Wr[h1]/wr);
-        v = - wl/w*wr/w*g*g;
-      }
-      if( v<vBst && data1[j2]-data1[j1]>=1e-6f ) {
-        vBst=v; fid=i+1; thr=0.5f*(data1[j1]+data1[j2]); }
+  nodeInit(H,N,hs,ws,split,W,w,g,vInit); vBst=vInit; fid=1; thr=0;
+  // find best threshold for each feature (each thread has own buffers)
+  #ifdef USEOMP
+  nThreads = min(nThreads,omp_get_max_threads());
+  #pragma omp parallel num_threads(nThreads)
+  #endif
+  {
+    double *Wl=new double[H], *Wr=new double[H], *Wb=0; uint32 *cb=0;
+    if( dataQ ) { Wb=new double[256*H](); cb=new uint32[256](); }
+    #ifdef USEOMP
+    #pragma omp for schedule(dynamic)
+    #endif
+    for( int f=0; f<F; f++ ) {
+      vs[f]=vInit; ts[f]=0; if( dataQ )
+        findThrBin(H,N,dataQ+f*size_t(N),hs,ws,edges+f*size_t(E),E,split,
+          W,w,g,Wl,Wr,Wb,cb,vs[f],ts[f]);
+      else
+        findThr(H,N,data+f*size_t(N),hs,ws,order+f*size_t(N),split,
+          W,w,g,Wl,Wr,vs[f],ts[f]);
     }
+    delete [] Wl; delete [] Wr; delete [] Wb; delete [] cb;
   }
-  delete [] Wl; delete [] Wr; delete [] W; gain = vInit-vBst;
+  // select best feature (ties broken by lowest fid so result is deterministic)
+  for( i=0; i<F; i++ ) if( vs[i]<vBst ) { vBst=vs[i]; fid=i+1; thr=ts[i]; }
+  delete [] W; delete [] vs; delete [] ts; gain = vInit-vBst;
 }
 
-// [fid,thr,gain] = mexFunction(data,hs,ws,order,H,split);
+// [fid,thr,gain] = mexFunction(data,hs,ws,order,H,split,[nThreads]);
+// If data is uint8 it is assumed to be quantized, where bin(x) is the number
+// of edges<=x, and the [ExF] single bin edges must be passed in place of order.
+// Splits are then found using per node class histograms (order is not used).
 void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
-  int H, N, F, split; float *data, *ws, thr;
-  double gain; uint32 *hs, *order, fid;
-  data = (float*) mxGetData(prhs[0]);
+  int H, N, F, E=0, split, nThreads; float *data=0, *ws, *edges=0, thr;
+  double gain; uint32 *hs, *order=0, fid; uint8 *dataQ=0;
   hs = (uint32*) mxGetData(prhs[1]);
   ws = (float*) mxGetData(prhs[2]);
-  order = (uint32*) mxGetData(prhs[3]);
   H = (int) mxGetScalar(prhs[4]);
   split = (int) mxGetScalar(prhs[5]);
+  nThreads = (nrhs<7) ? 1 : (int) mxGetScalar(prhs[6]);
   N = (int) mxGetM(prhs[0]);
   F = (int) mxGetN(prhs[0]);
-  forestFindThr(H,N,F,data,hs,ws,order,split,fid,thr,gain);
+  if( mxGetClassID(prhs[0])==mxUINT8_CLASS ) {
+    dataQ = (uint8*) mxGetData(prhs[0]);
+    edges = (float*) mxGetData(prhs[3]);
+    E = (int) mxGetM(prhs[3]);
+    if( mxGetClassID(prhs[3])!=mxSINGLE_CLASS || int(mxGetN(prhs[3]))!=F
+      || E<1 || E>255 ) mexErrMsgTxt("edges must be single [ExF] w E<256.");
+  } else {
+    data = (float*) mxGetData(prhs[0]);
+    order = (uint32*) mxGetData(prhs[3]);
+  }
+  forestFindThr(H,N,F,data,dataQ,hs,ws,order,edges,E,split,nThreads,
+    fid,thr,gain);
   plhs[0] = mxCreateDoubleScalar(fid);
   plhs[1] = mxCreateDoubleScalar(thr);
   plhs[2] = mxCreateDoubleScalar(gain);
@@ -0,0 +1,109 @@
+/*******************************************************************************
+* Piotr's Computer Vision Matlab Toolbox      Version 3.50
+* Copyright 2014 Piotr Dollar.  [pdollar-at-gmail.com]
+* Licensed under the Simplified BSD License [see external/bsd.txt]
+*******************************************************************************/
+#ifndef _FORESTFINDTHR_HPP_
+#define _FORESTFINDTHR_HPP_
+#include <stdint.h>
+#include <math.h>
+
+typedef unsigned int uint32;
+typedef unsigned char uint8;
+#define gini(p) p*p
+#define entropy(p) (-p*flog2(float(p)))
+
+// fast approximate log2(x) from Paul Mineiro <paul@mineiro.com>
+inline float flog2( float x ) {
+  union { float f; uint32_t i; } vx = { x };
+  union { uint32_t i; float f; } mx = { (vx.i & 0x007FFFFF) | 0x3f000000 };
+  float y = float(vx.i); y *= 1.1920928955078125e-7f;
+  return y - 124.22551499f - 1.498030302f * mx.f
+    - 1.72587999f / (0.3520887068f + mx.f);
+}
+
+// compute class weights W, total weight w, impurity sum g and value vInit
+inline void nodeInit( int H, int N, const uint32 *hs, const float *ws,
+  const int split, double *W, double &w, double &g, double &vInit )
+{
+  int i, j; g=0; w=0; vInit=0;
+  for( i=0; i<H; i++ ) W[i] = 0;
+  for( j=0; j<N; j++ ) { w+=ws[j]; W[hs[j]-1]+=ws[j]; }
+  if( split==0 ) { for( i=0; i<H; i++ ) g+=gini(W[i]); vInit=(1-g/w/w); }
+  if( split==1 ) { for( i=0; i<H; i++ ) g+=entropy(W[i]); vInit=g/w; }
+}
+
+// find best threshold for single feature (data is sorted by feature value)
+inline void findThr( int H, int N, const float *data1, const uint32 *hs,
+  const float *ws, const uint32 *order1, const int split, const double *W,
+  const double w, const double g0, double *Wl, double *Wr,
+  double &vBst, float &thr )
+{
+  int j, j1, j2, h; double v, wl, wr, g, gl, gr;
+  for( j=0; j<H; j++ ) { Wl[j]=0; Wr[j]=W[j]; } gl=wl=0; gr=g0; wr=w;
+  for( j=0; j<N-1; j++ ) {
+    j1=order1[j]; j2=order1[j+1]; h=hs[j1]-1;
+    if(split==0) {
+      // gini = 1-\sum_h p_h^2; v = gini_l*pl + gini_r*pr
+      wl+=ws[j1]; gl-=gini(Wl[h]); Wl[h]+=ws[j1]; gl+=gini(Wl[h]);
+      wr-=ws[j1]; gr-=gini(Wr[h]); Wr[h]-=ws[j1]; gr+=gini(Wr[h]);
+      v = (wl-gl/wl)/w + (wr-gr/wr)/w;
+    } else if (split==1) {
+      // entropy = -\sum_h p_h log(p_h); v = entropy_l*pl + entropy_r*pr
+      gl+=entropy(wl); wl+=ws[j1]; gl-=entropy(wl);
+      gr+=entropy(wr); wr-=ws[j1]; gr-=entropy(wr);
+      gl-=entropy(Wl[h]); Wl[h]+=ws[j1]; gl+=entropy(Wl[h]);
+      gr-=entropy(Wr[h]); Wr[h]-=ws[j1]; gr+=entropy(Wr[h]);
+      v = gl/w + gr/w;
+    } else {
+      // twoing: v = pl*pr*\sum_h(|p_h_left - p_h_right|)^2 [slow if H>>0]
+      wl+=ws[j1]; Wl[h]+=ws[j1]; wr-=ws[j1]; Wr[h]-=ws[j1];
+      g=0; for( int h1=0; h1<H; h1++ ) g+=fabs(Wl[h1]/wl-Wr[h1]/wr);
+      v = - wl/w*wr/w*g*g;
+    }
+    if( v<vBst && data1[j2]-data1[j1]>=1e-6f ) {
+      vBst=v; thr=0.5f*(data1[j1]+data1[j2]); }
+  }
+}
+
+// find best threshold for single quantized feature using class histograms
+// (the [256xH] Wb and [256] cb buffers must be zero on entry and are left
+// zero on exit, only the bins touched by the data are cleared)
+inline void findThrBin( int H, int N, const uint8 *data1, const uint32 *hs,
+  const float *ws, const float *edges1, const int E, const int split,
+  const double *W, const double w, const double g0, double *Wl, double *Wr,
+  double *Wb, uint32 *cb, double &vBst, float &thr )
+{
+  int j, b, h, n=0; double v, wb, wl, wr, g, gl, gr; double *Wb1;
+  for( j=0; j<N; j++ ) { b=data1[j]; Wb[b*H+hs[j]-1]+=ws[j]; cb[b]++; }
+  for( j=0; j<H; j++ ) { Wl[j]=0; Wr[j]=W[j]; } gl=wl=0; gr=g0; wr=w;
+  for( b=0; b<E; b++ ) {
+    // only split after non-empty bins and if right side is non-empty
+    if( cb[b]==0 ) continue; else n+=cb[b];
+    if( n>=N ) break; else Wb1=Wb+b*H;
+    if(split==0) {
+      for( h=0; h<H; h++ ) { wb=Wb1[h]; if(wb==0) continue;
+        wl+=wb; gl-=gini(Wl[h]); Wl[h]+=wb; gl+=gini(Wl[h]);
+        wr-=wb; gr-=gini(Wr[h]); Wr[h]-=wb; gr+=gini(Wr[h]); }
+      v = (wl-gl/wl)/w + (wr-gr/wr)/w;
+    } else if (split==1) {
+      wb=0; for( h=0; h<H; h++ ) wb+=Wb1[h];
+      gl+=entropy(wl); wl+=wb; gl-=entropy(wl);
+      gr+=entropy(wr); wr-=wb; gr-=entropy(wr);
+      for( h=0; h<H; h++ ) { wb=Wb1[h]; if(wb==0) continue;
+        gl-=entropy(Wl[h]); Wl[h]+=wb; gl+=entropy(Wl[h]);
+        gr-=entropy(Wr[h]); Wr[h]-=wb; gr+=entropy(Wr[h]); }
+      v = gl/w + gr/w;
+    } else {
+      for( h=0; h<H; h++ ) { wb=Wb1[h];
+        wl+=wb; Wl[h]+=wb; wr-=wb; Wr[h]-=wb; }
+      g=0; for( h=0; h<H; h++ ) g+=fabs(Wl[h]/wl-Wr[h]/wr);
+      v = - wl/w*wr/w*g*g;
+    }
+    // x<edges1[b] iff x falls in bin b or lower
+    if( v<vBst ) { vBst=v; thr=edges1[b]; }
+  }
+  for( j=0; j<N; j++ ) { b=data1[j]; Wb[b*H+hs[j]-1]=0; cb[b]=0; }
+}
+
+#endif
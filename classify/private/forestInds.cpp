@@ -4,49 +4,111 @@
 * Licensed under the Simplified BSD License [see external/bsd.txt]
 *******************************************************************************/
 #include <mex.h>
+#include <vector>
+#include "packBlocks.hpp"
 #ifdef USEOMP
 #include <omp.h>
 #endif
 
 typedef unsigned char uint8;
-typedef unsigned int uint32;
 #define min(x,y) ((x) < (y) ? (x) : (y))
 
+// find leaf reached by each of n samples given packed block buf [F1xn]
 template<typename T>
-void forestInds( uint32 *inds, const T *data, const T *thrs,
-  const uint32 *fids, const uint32 *child, int N, int nThreads )
+inline void treeLeaves( const T *buf, int n, int F1, const T *thrs,
+  const uint32 *fids, const uint32 *child, uint32 *leaves )
 {
+  for( int i = 0; i < n; i++ ) {
+    const T *x = buf+i*size_t(F1); uint32 k = 0;
+    while( child[k] )
+      if( x[fids[k]] < thrs[k] )
+        k = child[k]-1; else k = child[k];
+    leaves[i] = k;
+  }
+}
+
+// Apply M trees (stored as [KxM] arrays). If distr is NULL store the leaf
+// inds in the [NxM] array inds, otherwise sum the [KxHxM] leaf distributions
+// into the [NxH] array ps. Data is repacked into row-major blocks of samples
+// (see packBlocks.hpp) and all trees are applied to each block in turn.
+template<typename T>
+void forestInds( uint32 *inds, double *ps, const T *data, const T *thrs,
+  const uint32 *fids, const uint32 *child, const float *distr,
+  int N, int F, int K, int M, int H, int nThreads )
+{
+  std::vector<uint32> fids1, used; int F1, B, nBlocks;
+  F1 = packFids(fids,child,size_t(K)*M,F,fids1,used);
+  if( F1<0 ) mexErrMsgTxt("Feature ids out of range.");
+  B = packBlockSize(F1,sizeof(T)); nBlocks = (N+B-1)/B;
   #ifdef USEOMP
   nThreads = min(nThreads,omp_get_max_threads());
-  #pragma omp parallel for num_threads(nThreads)
+  #pragma omp parallel num_threads(nThreads)
   #endif
-  for( int i = 0; i < N; i++ ) {
-    uint32 k = 0;
-    while( child[k] )
-      if( data[i+fids[k]*size_t(N)] < thrs[k] )
-        k = child[k]-1; else k = child[k];
-    inds[i] = k+1;
+  {
+    std::vector<T> buf(size_t(B)*F1+1); std::vector<uint32> leaves(B);
+    #ifdef USEOMP
+    #pragma omp for
+    #endif
+    for( int b = 0; b < nBlocks; b++ ) {
+      int i0 = b*B, n = min(B,N-i0);
+      if( F1 ) packBlock(data,N,i0,n,&used[0],F1,&buf[0]);
+      for( int m = 0; m < M; m++ ) {
+        size_t o = m*size_t(K); uint32 *l = &leaves[0];
+        treeLeaves(&buf[0],n,F1,thrs+o,&fids1[o],child+o,l);
+        if( !distr ) {
+          uint32 *inds1 = inds+m*size_t(N)+i0;
+          for( int i = 0; i < n; i++ ) inds1[i] = l[i]+1;
+        } else for( int h = 0; h < H; h++ ) {
+          const float *d = distr+o*H+h*size_t(K);
+          double *ps1 = ps+h*size_t(N)+i0;
+          for( int i = 0; i < n; i++ ) ps1[i] += d[l[i]];
+        }
+      }
+    }
   }
 }
 
-// inds=mexFunction(data,thrs,fids,child,[nThreads])
+// inds=mexFunction(data,thrs,fids,child,[nThreads],[distr])
+// If thrs, fids and child are [KxM] arrays, the M trees are applied jointly
+// (in blocks of samples) and inds is [NxM]. If a single [KxHxM] distr array
+// is given, the output is instead the [NxH] sum over trees of the rows of
+// distr corresponding to the reached leaves (for regression use H=1).
 void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
-  int N, nThreads; void *data, *thrs; uint32 *inds, *fids, *child;
+  int N, F, K, M, H=0, nThreads; void *data, *thrs; uint32 *inds=0, *fids;
+  uint32 *child; mxClassID id; float *distr=0; double *ps=0;
   data = mxGetData(prhs[0]);
   thrs = mxGetData(prhs[1]);
   fids = (uint32*) mxGetData(prhs[2]);
   child = (uint32*) mxGetData(prhs[3]);
-  nThreads = (nrhs<5) ? 100000 : (int) mxGetScalar(prhs[4]);
+  nThreads = (nrhs<5 || mxIsEmpty(prhs[4])) ? 100000
+    : (int) mxGetScalar(prhs[4]);
   N = (int) mxGetM(prhs[0]);
-  plhs[0] = mxCreateNumericMatrix(N,1,mxUINT32_CLASS,mxREAL);
-  inds = (uint32*) mxGetPr(plhs[0]);
-  if(mxGetClassID(prhs[0])!=mxGetClassID(prhs[1]))
+  F = (int) mxGetN(prhs[0]);
+  K = (int) mxGetM(prhs[1]);
+  M = (int) mxGetN(prhs[1]);
+  id = mxGetClassID(prhs[0]);
+  if(id!=mxGetClassID(prhs[1]))
     mexErrMsgTxt("Mismatch between data types.");
-  if(mxGetClassID(prhs[0])==mxSINGLE_CLASS)
-    forestInds(inds,(float*)data,(float*)thrs,fids,child,N,nThreads);
-  else if(mxGetClassID(prhs[0])==mxDOUBLE_CLASS)
-    forestInds(inds,(double*)data,(double*)thrs,fids,child,N,nThreads);
-  else if(mxGetClassID(prhs[0])==mxUINT8_CLASS)
-    forestInds(inds,(uint8*)data,(uint8*)thrs,fids,child,N,nThreads);
+  if(int(mxGetNumberOfElements(prhs[2]))!=K*M ||
+    int(mxGetNumberOfElements(prhs[3]))!=K*M )
+    mexErrMsgTxt("thrs, fids and child must have same size.");
+  if( nrhs<6 ) {
+    plhs[0] = mxCreateNumericMatrix(N,M,mxUINT32_CLASS,mxREAL);
+    inds = (uint32*) mxGetData(plhs[0]);
+  } else {
+    distr = (float*) mxGetData(prhs[5]);
+    H = (int) (mxGetNumberOfElements(prhs[5])/(size_t(K)*M));
+    if(mxGetClassID(prhs[5])!=mxSINGLE_CLASS || size_t(K)*M*H==0
+      || mxGetM(prhs[5])!=size_t(K) || mxGetNumberOfElements(prhs[5])
+      !=size_t(K)*M*H ) mexErrMsgTxt("distr must be single [KxHxM].");
+    plhs[0] = mxCreateNumericMatrix(N,H,mxDOUBLE_CLASS,mxREAL);
+    ps = (double*) mxGetData(plhs[0]);
+  }
+  if(id==mxSINGLE_CLASS) forestInds(inds,ps,(float*)data,
+    (float*)thrs,fids,child,distr,N,F,K,M,H,nThreads);
+  else if(id==mxDOUBLE_CLASS) forestInds(inds,ps,(double*)data,
+    (double*)thrs,fids,child,distr,N,F,K,M,H,nThreads);
+  else if(id==mxUINT8_CLASS) forestInds(inds,ps,(uint8*)data,
+    (uint8*)thrs,fids,child,distr,N,F,K,M,H,nThreads);
   else mexErrMsgTxt("Unknown data type.");
 }
@@ -0,0 +1,211 @@
+/*******************************************************************************
+* Piotr's Computer Vision Matlab Toolbox      Version 3.50
+* Copyright 2014 Piotr Dollar.  [pdollar-at-gmail.com]
+* Licensed under the Simplified BSD License [see external/bsd.txt]
+*******************************************************************************/
+#include <mex.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "packBlocks.hpp"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+#ifdef USEOMP
+#include <omp.h>
+#endif
+
+typedef unsigned short uint16;
+#define min(x,y) ((x) < (y) ? (x) : (y))
+
+// node of a packed forest (see forestPack.m), child==0 indicates a leaf
+struct PNode { uint16 fid, child; union { float thr; uint32 leaf; }; };
+typedef char PNodeSizeCheck[sizeof(PNode)==8 ? 1 : -1];
+
+// view of a packed forest (pointers into the serialized data)
+struct PForest {
+  uint32 M, H, F, nNodes, nLeaves; const uint32 *offs, *leafIds;
+  const PNode *nodes; const uint16 *distr;
+};
+
+// Parse and validate packed forest of n bytes (returns error or NULL). All
+// nodes are checked so that traversal of a corrupt model cannot go astray.
+const char* parseForest( const unsigned char *b, size_t n, PForest &f ) {
+  const uint32 *h=(const uint32*) b; size_t o;
+  if( n<32 || memcmp(b,"PFST",4) ) return "Invalid packed forest.";
+  if( h[1]!=1 ) return "Unsupported packed forest version.";
+  f.M=h[2]; f.H=h[3]; f.F=h[4]; f.nNodes=h[5]; f.nLeaves=h[6];
+  o=32+(size_t(f.M+1)+1)/2*8; f.offs=h+8;
+  if( n<o ) return "Truncated packed forest.";
+  f.nodes=(const PNode*) (b+o); o+=size_t(f.nNodes)*8;
+  f.leafIds=(const uint32*) (b+o); o+=size_t(f.nLeaves)*4;
+  f.distr=(const uint16*) (b+o); o+=size_t(f.nLeaves)*f.H*2;
+  if( n<o || !f.M || f.offs[0] || f.offs[f.M]!=f.nNodes )
+    return "Truncated or corrupt packed forest.";
+  for( uint32 m=0; m<f.M; m++ ) {
+    uint32 k0=f.offs[m], K=f.offs[m+1]-k0; const PNode *nd=f.nodes+k0;
+    if( f.offs[m+1]<=k0 ) return "Corrupt packed forest.";
+    for( uint32 k=0; k<K; k++ ) if( nd[k].child ) {
+      if( nd[k].child<=k || nd[k].child+1u>=K || nd[k].fid>=f.F )
+        return "Corrupt packed forest.";
+    } else if( nd[k].leaf>=f.nLeaves ) return "Corrupt packed forest.";
+  }
+  return NULL;
+}
+
+// parsed packed forest together with its packed feature map (see packFids)
+struct PModel { PForest f; std::vector<uint32> fids1, used; int F1; };
+
+// Parse and validate packed forest of n bytes and build its feature map
+const char* parseModel( const unsigned char *b, size_t n, PModel &m ) {
+  const char *err=parseForest(b,n,m.f); if( err ) return err;
+  const PForest &f=m.f; std::vector<uint32> fids(f.nNodes), child(f.nNodes);
+  for( uint32 k=0; k<f.nNodes; k++ ) {
+    fids[k]=f.nodes[k].fid; child[k]=f.nodes[k].child; }
+  m.F1 = packFids(&fids[0],&child[0],f.nNodes,int(f.F),m.fids1,m.used);
+  return m.F1<0 ? "Corrupt packed forest." : NULL;
+}
+
+/*******************************************************************************
+* Read only memory mapped model files. Files are mapped on first use and stay
+* mapped (so that later calls do not touch the disk) until the mex file is
+* cleared. The model is parsed and validated once when it is mapped. A file
+* is remapped if its size or modification time changes, rewriting a model
+* file in place while it is mapped (keeping its size within the same second)
+* is not supported, write a new file and rename it instead.
+*******************************************************************************/
+struct MappedFile {
+  const unsigned char *data; size_t n; time_t mtime; PModel model;
+  const char *err;
+  #ifdef _WIN32
+  HANDLE file, map;
+  #endif
+};
+static std::map<std::string,MappedFile> mappedFiles;
+
+void unmapFile( MappedFile &mf ) {
+  #ifdef _WIN32
+  UnmapViewOfFile(mf.data); CloseHandle(mf.map); CloseHandle(mf.file);
+  #else
+  munmap((void*) mf.data,mf.n);
+  #endif
+}
+
+void unmapAll() {
+  std::map<std::string,MappedFile>::iterator it;
+  for( it=mappedFiles.begin(); it!=mappedFiles.end(); it++ )
+    unmapFile(it->second);
+  mappedFiles.clear();
+}
+
+const MappedFile* mapFile( const char *fName ) {
+  struct stat st; MappedFile mf; void *p=NULL;
+  if( stat(fName,&st) || st.st_size<=0 ) return NULL;
+  std::map<std::string,MappedFile>::iterator it=mappedFiles.find(fName);
+  if( it!=mappedFiles.end() ) {
+    if( it->second.n==size_t(st.st_size) && it->second.mtime==st.st_mtime )
+      return &it->second;
+    unmapFile(it->second); mappedFiles.erase(it);
+  }
+  mf.n=size_t(st.st_size); mf.mtime=st.st_mtime;
+  #ifdef _WIN32
+  mf.file=CreateFileA(fName,GENERIC_READ,FILE_SHARE_READ,NULL,OPEN_EXISTING,
+    FILE_ATTRIBUTE_NORMAL,NULL);
+  if( mf.file==INVALID_HANDLE_VALUE ) return NULL;
+  mf.map=CreateFileMappingA(mf.file,NULL,PAGE_READONLY,0,0,NULL);
+  if( mf.map ) p=MapViewOfFile(mf.map,FILE_MAP_READ,0,0,0);
+  if( !p ) { if(mf.map) CloseHandle(mf.map); CloseHandle(mf.file); }
+  #else
+  int fd=open(fName,O_RDONLY); if( fd<0 ) return NULL;
+  p=mmap(NULL,mf.n,PROT_READ,MAP_SHARED,fd,0); close(fd);
+  if( p==MAP_FAILED ) p=NULL;
+  #endif
+  if( !p ) return NULL;
+  mf.data=(const unsigned char*) p; mf.err=parseModel(mf.data,mf.n,mf.model);
+  return &(mappedFiles[fName]=mf);
+}
+
+// Apply all trees of packed forest m to single data [NxF]. If ps is NULL
+// store the original (1-based) node index of the leaves reached in the
+// [NxM] array inds, otherwise sum the dequantized leaf distributions into
+// the [NxH] array ps. Data is processed in row-major blocks (as forestInds).
+void forestInds( uint32 *inds, double *ps, const float *data, int N,
+  const PModel &m, int nThreads )
+{
+  const PForest &f=m.f; const uint32 *fids1=&m.fids1[0];
+  const uint32 *used=m.F1 ? &m.used[0] : NULL;
+  int F1=m.F1, B, nBlocks, M=int(f.M), H=int(f.H); const double s=1.0/65535;
+  B = packBlockSize(F1,sizeof(float)); nBlocks = (N+B-1)/B;
+  #ifdef USEOMP
+  nThreads = min(nThreads,omp_get_max_threads());
+  #pragma omp parallel num_threads(nThreads)
+  #endif
+  {
+    std::vector<float> buf(size_t(B)*F1+1);
+    #ifdef USEOMP
+    #pragma omp for
+    #endif
+    for( int b = 0; b < nBlocks; b++ ) {
+      int i0 = b*B, n = min(B,N-i0), i, h; uint32 k, leaf;
+      if( F1 ) packBlock(data,N,i0,n,used,F1,&buf[0]);
+      for( int m = 0; m < M; m++ ) {
+        const PNode *nd=f.nodes+f.offs[m]; const uint32 *fm=&fids1[f.offs[m]];
+        for( i = 0; i < n; i++ ) {
+          const float *x = &buf[i*size_t(F1)];
+          for( k=0; nd[k].child; ) k=nd[k].child+(x[fm[k]]<nd[k].thr ? 0:1);
+          leaf = nd[k].leaf;
+          if( !ps ) { inds[i0+i+m*size_t(N)]=f.leafIds[leaf]; continue; }
+          const uint16 *d = f.distr+size_t(leaf)*H;
+          for( h = 0; h < H; h++ ) ps[i0+i+h*size_t(N)] += d[h];
+        }
+      }
+      if( ps ) for( h = 0; h < H; h++ ) for( i = 0; i < n; i++ )
+        ps[i0+i+h*size_t(N)] *= s;
+    }
+  }
+}
+
+// [out,M]=mexFunction(data,model,[nThreads],[distrFlag])
+// Apply a packed forest (see forestPack.m) to single data [NxF]. model is
+// either the uint8 packed forest or the name of a file containing it (which
+// is memory mapped). If distrFlag the output is the [NxH] sum over trees of
+// the leaf distributions, otherwise the [NxM] uint32 indices of the leaves
+// reached (identical to forestInds applied to the original forest). The
+// optional second output is the number of trees M.
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+  int N, F, nThreads; bool distrFlag; PModel model; const PModel *m=&model;
+  const char *err; uint32 *inds=0; double *ps=0;
+  if( nrhs<2 ) mexErrMsgTxt("At least two inputs required.");
+  nThreads = (nrhs<3 || mxIsEmpty(prhs[2])) ? 100000
+    : (int) mxGetScalar(prhs[2]);
+  distrFlag = nrhs>3 && mxGetScalar(prhs[3])!=0;
+  if( !mxIsSingle(prhs[0]) ) mexErrMsgTxt("data must be of type single.");
+  N = (int) mxGetM(prhs[0]); F = (int) mxGetN(prhs[0]);
+  if( mxIsChar(prhs[1]) ) {
+    char *fName=mxArrayToString(prhs[1]); const MappedFile *mf;
+    mexAtExit(unmapAll); mf=mapFile(fName); mxFree(fName);
+    if( !mf ) mexErrMsgTxt("Unable to map packed forest file.");
+    err=mf->err; m=&mf->model;
+  } else if( mxIsUint8(prhs[1]) ) {
+    err=parseModel((const unsigned char*) mxGetData(prhs[1]),
+      mxGetNumberOfElements(prhs[1]),model);
+  } else mexErrMsgTxt("model must be uint8 or a file name.");
+  if( err ) mexErrMsgTxt(err);
+  const PForest &f=m->f;
+  if( int(f.F)>F ) mexErrMsgTxt("Too few features in data.");
+  if( distrFlag ) {
+    plhs[0] = mxCreateNumericMatrix(N,f.H,mxDOUBLE_CLASS,mxREAL);
+    ps = (double*) mxGetData(plhs[0]);
+  } else {
+    plhs[0] = mxCreateNumericMatrix(N,f.M,mxUINT32_CLASS,mxREAL);
+    inds = (uint32*) mxGetData(plhs[0]);
+  }
+  forestInds(inds,ps,(float*) mxGetData(prhs[0]),N,*m,nThreads);
+  if( nlhs>1 ) plhs[1] = mxCreateDoubleScalar(f.M);
+}
@@ -0,0 +1,226 @@
+/*******************************************************************************
+* Piotr's Computer Vision Matlab Toolbox      Version 3.50
+* Copyright 2014 Piotr Dollar.  [pdollar-at-gmail.com]
+* Licensed under the Simplified BSD License [see external/bsd.txt]
+*******************************************************************************/
+#include <mex.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include "forestFindThr.hpp"
+#ifdef USEOMP
+#include <omp.h>
+#endif
+
+// node of a tree being trained (range [start,start+n) of the tree's samples)
+struct Node { int t, k, start, n, depth, nLeft; };
+
+// tree being trained (distr is stored as [HxK])
+struct Tree { std::vector<uint32> fids, child, count, depth, hs, pos;
+  std::vector<float> thrs, distr; };
+
+// training parameters and read-only data shared across all threads
+struct Params { int N, F, E, N1, H, F1, minCount, minChild, maxDepth, split;
+  const float *data, *edges, *ws, *fWts; const uint8 *dataQ;
+  const uint32 *hs, *dids; uint32 seed; bool uniform; };
+
+// per thread buffers
+struct Buffers { std::vector<float> data1, ws1; std::vector<uint8> dataQ1;
+  std::vector<uint32> order1, hs1, fids1, mark, cb;
+  std::vector<double> W, Wl, Wr, Wb; uint32 stamp; };
+
+// simple deterministic random number generator (xorshift32)
+inline uint32 rngNext( uint32 &s ) { s^=s<<13; s^=s>>17; s^=s<<5; return s; }
+
+// generator for node k of tree t (results do not depend on number of threads)
+inline uint32 rngInit( uint32 seed, int t, int k ) {
+  uint32 s=seed^(uint32(t+1)*2654435761u)^(uint32(k+1)*2246822519u);
+  if( !s ) s=1;
+  rngNext(s); rngNext(s); return s;
+}
+
+// sample F1 of F features without replacement (weighted by fWts)
+void sampleFids( const Params &p, uint32 &s, Buffers &b ) {
+  int i, F=p.F, F1=p.F1; uint32 *fids1=&b.fids1[0], *mark=&b.mark[0];
+  if( F1==F ) { for( i=0; i<F; i++ ) fids1[i]=i; return; }
+  if( p.uniform ) {
+    // rejection sampling (marks are reset by incrementing stamp)
+    if(++b.stamp==0) { std::fill(b.mark.begin(),b.mark.end(),0); b.stamp=1; }
+    for( i=0; i<F1; ) { uint32 f=rngNext(s)%F; if(mark[f]==b.stamp) continue;
+      mark[f]=b.stamp; fids1[i++]=f; }
+  } else {
+    // keep F1 features with largest keys log(u)/w [Efraimidis & Spirakis]
+    std::vector<std::pair<float,uint32> > kf(F);
+    for( i=0; i<F; i++ ) { float u=((rngNext(s)>>8)+.5f)/16777216.f;
+      float key=p.fWts[i]>0 ? logf(u)/p.fWts[i] : -1e30f;
+      kf[i]=std::make_pair(-key,uint32(i)); }
+    std::nth_element(kf.begin(),kf.begin()+F1,kf.end());
+    for( i=0; i<F1; i++ ) fids1[i]=kf[i].second;
+  }
+}
+
+// comparator used to sort samples by feature value (nan last, as in sort.m)
+struct DataCmp { const float *d; DataCmp(const float *d) : d(d) {}
+  bool operator()(uint32 a, uint32 b) const {
+    return d[a]<d[b] || (d[a]==d[a] && d[b]!=d[b]); } };
+
+// train single node (store distribution, find split, partition samples)
+void trainNode( const Params &p, Node &nd, Tree &tree, Buffers &b ) {
+  int i, j, n=nd.n, k=nd.k, H=p.H, fid=0; uint32 s, *pos=&tree.pos[nd.start];
+  const uint32 *dids=p.dids+nd.t*size_t(p.N1);
+  const float *ws=p.ws+nd.t*size_t(p.N1);
+  uint32 *hs1=&b.hs1[0]; float *ws1=&b.ws1[0], *dist=&tree.distr[k*H], thr=0;
+  double w, g, vInit, vBst, v; bool pure=true; nd.nLeft=0;
+  // gather labels/weights and store distribution
+  for( j=0; j<n; j++ ) { hs1[j]=p.hs[dids[pos[j]]]; ws1[j]=ws[pos[j]]; }
+  for( i=0; i<H; i++ ) dist[i]=0;
+  for( j=0; j<n; j++ ) { dist[hs1[j]-1]++; pure=pure && hs1[j]==hs1[0]; }
+  for( i=0; i<H; i++ ) { dist[i]/=n; if(dist[i]>dist[fid]) fid=i; }
+  tree.count[k]=n; tree.hs[k]=pure ? hs1[0] : fid+1;
+  // if pure node or insufficient data don't train split
+  if( pure || n<=p.minCount || nd.depth>p.maxDepth ) return;
+  // find best split over sampled features (ties broken by lowest position)
+  nodeInit(H,n,hs1,ws1,p.split,&b.W[0],w,g,vInit); vBst=vInit;
+  s=rngInit(p.seed,nd.t,k); sampleFids(p,s,b); fid=-1;
+  for( i=0; i<p.F1; i++ ) {
+    int f=b.fids1[i]; float thr1=0; v=vInit;
+    if( p.dataQ ) {
+      const uint8 *d=p.dataQ+f*size_t(p.N); uint8 *d1=&b.dataQ1[0];
+      for( j=0; j<n; j++ ) d1[j]=d[dids[pos[j]]];
+      findThrBin(H,n,d1,hs1,ws1,p.edges+f*size_t(p.E),p.E,p.split,&b.W[0],
+        w,g,&b.Wl[0],&b.Wr[0],&b.Wb[0],&b.cb[0],v,thr1);
+    } else {
+      const float *d=p.data+f*size_t(p.N); float *d1=&b.data1[0];
+      uint32 *o1=&b.order1[0];
+      for( j=0; j<n; j++ ) { d1[j]=d[dids[pos[j]]]; o1[j]=j; }
+      std::sort(o1,o1+n,DataCmp(d1));
+      findThr(H,n,d1,hs1,ws1,o1,p.split,&b.W[0],w,g,
+        &b.Wl[0],&b.Wr[0],v,thr1);
+    }
+    if( v<vBst ) { vBst=v; fid=f; thr=thr1; }
+  }
+  if( fid<0 || vInit-vBst<=1e-10 ) return;
+  // determine which samples go left (x<thr iff bin(x)<=bin(thr) if quantized)
+  std::vector<char> left(n); int nLeft=0;
+  if( p.dataQ ) {
+    const float *e=p.edges+fid*size_t(p.E); int bin=0;
+    const uint8 *d=p.dataQ+fid*size_t(p.N); while( e[bin]!=thr ) bin++;
+    for( j=0; j<n; j++ ) nLeft+=left[j]=(d[dids[pos[j]]]<=bin);
+  } else {
+    const float *d=p.data+fid*size_t(p.N);
+    for( j=0; j<n; j++ ) nLeft+=left[j]=(d[dids[pos[j]]]<thr);
+  }
+  if( nLeft<p.minChild || n-nLeft<p.minChild ) return;
+  // stable in place partition of samples into left and right child
+  uint32 *tmp=&b.order1[0]; int l=0, r=nLeft;
+  for( j=0; j<n; j++ ) tmp[left[j] ? l++ : r++]=pos[j];
+  for( j=0; j<n; j++ ) pos[j]=tmp[j];
+  tree.fids[k]=fid; tree.thrs[k]=thr; nd.nLeft=nLeft;
+}
+
+// add node to tree (resizing all arrays)
+void addNode( Tree &tree, int H, uint32 depth ) {
+  tree.fids.push_back(0); tree.thrs.push_back(0); tree.child.push_back(0);
+  tree.count.push_back(0); tree.depth.push_back(depth); tree.hs.push_back(0);
+  tree.distr.resize(tree.distr.size()+H);
+}
+
+// create mxArray from vector (storing as type T)
+template<class T> mxArray* toMx( const std::vector<T> &v, int m, int n,
+  mxClassID id )
+{
+  mxArray *A=mxCreateNumericMatrix(m,n,id,mxREAL);
+  if( m>0 && n>0 ) memcpy(mxGetData(A),&v[0],m*n*sizeof(T));
+  return A;
+}
+
+// forest = mexFunction( data, edges, hs, dids, ws, fWts, H, F1, minCount,
+//   minChild, maxDepth, split, seed, nThreads )
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+  // get inputs
+  Params p; int i, t, M;
+  bool quant = mxGetClassID(prhs[0])==mxUINT8_CLASS;
+  p.data = quant ? 0 : (float*) mxGetData(prhs[0]);
+  p.dataQ = quant ? (uint8*) mxGetData(prhs[0]) : 0;
+  p.edges = quant ? (float*) mxGetData(prhs[1]) : 0;
+  p.hs = (uint32*) mxGetData(prhs[2]);
+  p.dids = (uint32*) mxGetData(prhs[3]);
+  p.ws = (float*) mxGetData(prhs[4]);
+  p.fWts = (float*) mxGetData(prhs[5]);
+  p.H = (int) mxGetScalar(prhs[6]);
+  p.F1 = (int) mxGetScalar(prhs[7]);
+  p.minCount = (int) mxGetScalar(prhs[8]);
+  p.minChild = (int) mxGetScalar(prhs[9]);
+  p.maxDepth = (int) mxGetScalar(prhs[10]);
+  p.split = (int) mxGetScalar(prhs[11]);
+  p.seed = (uint32) mxGetScalar(prhs[12]);
+  p.N = (int) mxGetM(prhs[0]);
+  p.F = (int) mxGetN(prhs[0]);
+  p.E = quant ? (int) mxGetM(prhs[1]) : 0;
+  p.N1 = (int) mxGetM(prhs[3]);
+  M = (int) mxGetN(prhs[3]);
+  if( quant && (mxGetClassID(prhs[1])!=mxSINGLE_CLASS ||
+    int(mxGetN(prhs[1]))!=p.F || p.E<1 || p.E>255) )
+    mexErrMsgTxt("edges must be single [ExF] w E<256.");
+  p.uniform=true; for( i=1; i<p.F; i++ ) p.uniform&=(p.fWts[i]==p.fWts[0]);
+
+  // initialize trees and frontier with root of every tree
+  std::vector<Tree> trees(M); std::vector<Node> nodes, next;
+  for( t=0; t<M; t++ ) {
+    Tree &tree=trees[t]; addNode(tree,p.H,0); tree.pos.resize(p.N1);
+    for( i=0; i<p.N1; i++ ) tree.pos[i]=i;
+    Node nd={t,0,0,p.N1,0,0}; nodes.push_back(nd);
+  }
+
+  // process nodes of all trees one level at a time
+  #ifdef USEOMP
+  int nThreads = (int) mxGetScalar(prhs[13]);
+  nThreads = std::min(nThreads,omp_get_max_threads());
+  #endif
+  while( nodes.size()>0 ) {
+    int nNodes=(int) nodes.size();
+    #ifdef USEOMP
+    #pragma omp parallel num_threads(std::min(nThreads,nNodes))
+    #endif
+    {
+      Buffers b; int n=p.N1, H=p.H; b.stamp=0;
+      b.hs1.resize(n); b.ws1.resize(n); b.order1.resize(n);
+      if(p.dataQ) b.dataQ1.resize(n); else b.data1.resize(n);
+      b.fids1.resize(p.F); b.mark.resize(p.F);
+      b.W.resize(H); b.Wl.resize(H); b.Wr.resize(H);
+      if(p.dataQ) { b.Wb.resize(256*H); b.cb.resize(256); }
+      #ifdef USEOMP
+      #pragma omp for schedule(dynamic)
+      #endif
+      for( i=0; i<nNodes; i++ ) trainNode(p,nodes[i],trees[nodes[i].t],b);
+    }
+    // assign children in order (same node ordering as breadth first search)
+    next.clear();
+    for( i=0; i<nNodes; i++ ) {
+      Node &nd=nodes[i]; if(!nd.nLeft) continue; Tree &tree=trees[nd.t];
+      int K=(int) tree.fids.size(); tree.child[nd.k]=K+1;
+      addNode(tree,p.H,nd.depth+1); addNode(tree,p.H,nd.depth+1);
+      Node l={nd.t,K,nd.start,nd.nLeft,nd.depth+1,0};
+      Node r={nd.t,K+1,nd.start+nd.nLeft,nd.n-nd.nLeft,nd.depth+1,0};
+      next.push_back(l); next.push_back(r);
+    }
+    nodes.swap(next);
+  }
+
+  // create output structure
+  const char *fnames[7]={"fids","thrs","child","distr","hs","count","depth"};
+  plhs[0] = mxCreateStructMatrix(M,1,7,fnames);
+  for( t=0; t<M; t++ ) {
+    Tree &tree=trees[t]; int K=(int) tree.fids.size(), H=p.H;
+    std::vector<float> distr(K*H); for( int k=0; k<K; k++ )
+      for( i=0; i<H; i++ ) distr[k+i*K]=tree.distr[k*H+i];
+    mxSetField(plhs[0],t,"fids",toMx(tree.fids,K,1,mxUINT32_CLASS));
+    mxSetField(plhs[0],t,"thrs",toMx(tree.thrs,K,1,mxSINGLE_CLASS));
+    mxSetField(plhs[0],t,"child",toMx(tree.child,K,1,mxUINT32_CLASS));
+    mxSetField(plhs[0],t,"distr",toMx(distr,K,H,mxSINGLE_CLASS));
+    mxSetField(plhs[0],t,"hs",toMx(tree.hs,K,1,mxUINT32_CLASS));
+    mxSetField(plhs[0],t,"count",toMx(tree.count,K,1,mxUINT32_CLASS));
+    mxSetField(plhs[0],t,"depth",toMx(tree.depth,K,1,mxUINT32_CLASS));
+  }
+}
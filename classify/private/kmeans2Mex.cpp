@@ -0,0 +1,195 @@
+/*******************************************************************************
+* Piotr's Computer Vision Matlab Toolbox      Version 3.50
+* Copyright 2014 Piotr Dollar.  [pdollar-at-gmail.com]
+* Licensed under the Simplified BSD License [see external/bsd.txt]
+*******************************************************************************/
+#include "mex.h"
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#ifdef USEOMP
+#include <omp.h>
+#endif
+
+typedef std::vector<double> vectord;
+typedef std::vector<int> vectori;
+
+// euclidean distance between p dimensional point x and center c
+template<class T> inline double dist( const T *x, const double *c, int p ) {
+  double d=0, v; for( int j=0; j<p; j++ ) { v=x[j]-c[j]; d+=v*v; }
+  return sqrt(d);
+}
+
+// nearest center to x (lowest index on ties) and distances d1 and d2 to the
+// nearest and second nearest centers (if ds is given all distances are kept)
+template<class T> inline int nearest( const T *x, const double *C, int k,
+  int p, double &d1, double &d2, double *ds )
+{
+  int j, a=0; double d; d1=d2=INFINITY;
+  for( j=0; j<k; j++ ) {
+    d=dist(x,C+j*size_t(p),p); if( ds ) ds[j]=d;
+    if( d<d1 ) { d2=d1; d1=d; a=j; } else if( d<d2 ) d2=d;
+  }
+  return a;
+}
+
+// half distance from each center to its nearest other center (s) and
+// optionally all pairwise center distances (cc, used by elkan only)
+void centerDists( const double *C, int k, int p, double *s, double *cc,
+  int nThreads )
+{
+  #ifdef USEOMP
+  #pragma omp parallel for num_threads(nThreads) schedule(dynamic)
+  #endif
+  for( int i=0; i<k; i++ ) {
+    double m=INFINITY; for( int j=0; j<k; j++ ) if( j!=i ) {
+      double d=dist(C+i*size_t(p),C+j*size_t(p),p)/2; m=d<m ? d : m;
+      if( cc ) cc[i*size_t(k)+j]=d;
+    }
+    s[i]=m;
+  }
+}
+
+// Lloyd iterations identical to kmeans2main (see kmeans2.m) except that
+// upper and lower bounds on the distance of every point to its nearest and
+// other centers are used to skip distance computations (Hamerly's single
+// lower bound per point or Elkan's one lower bound per point and center).
+// IDX must hold the previous assignment (used to detect convergence). Returns
+// 0 on convergence, otherwise all clusters got eliminated and the caller
+// must reseed (1 if the main loop ends afterwards, 2 if it resumes, passing
+// back the IDX returned, so that iterations continue exactly as before).
+template<class T> int kmeans( const T *X, int N, int p, double *C, int &k,
+  int nOut, int minCl, int maxt, bool elkan, bool sq, int nDg, int nThreads,
+  double *IDX, double *mind, int &t )
+{
+  const int K=k; int i, j, k0, changed=1; size_t Kl=elkan ? K : 1;
+  vectori a(N), full(N,1), cnt(K), map(K); vectord u(N), l(N*Kl);
+  vectord s(K), cc(elkan ? size_t(K)*K : 0), delta(K), C0(size_t(K)*p);
+  #ifdef USEOMP
+  nThreads = std::min(nThreads,omp_get_max_threads());
+  #endif
+  for( t=0; changed && t<maxt; ) {
+    // assign each point to closest cluster center (skipping when possible)
+    centerDists(C,k,p,&s[0],elkan ? &cc[0] : NULL,nThreads);
+    #ifdef USEOMP
+    #pragma omp parallel for num_threads(nThreads) schedule(dynamic,256)
+    #endif
+    for( int n=0; n<N; n++ ) {
+      const T *x=X+n*size_t(p); double *ln=&l[n*Kl], d1, d2;
+      if( full[n] ) {
+        a[n]=nearest(x,C,k,p,d1,d2,elkan ? ln : NULL);
+        u[n]=d1; if( !elkan ) ln[0]=d2; full[n]=0;
+      } else if( !elkan ) {
+        u[n]=dist(x,C+a[n]*size_t(p),p);
+        if( u[n]>=std::max(s[a[n]],ln[0]) ) {
+          a[n]=nearest(x,C,k,p,d1,d2,NULL); u[n]=d1; ln[0]=d2; }
+      } else {
+        int an=a[n]; double un=ln[an]=dist(x,C+an*size_t(p),p);
+        if( un>=s[an] ) for( int j1=0; j1<k; j1++ ) {
+          if( j1==an || un<ln[j1] || un<cc[an*size_t(k)+j1] ) continue;
+          double d=ln[j1]=dist(x,C+j1*size_t(p),p);
+          if( d<un || (d==un && j1<an) ) { an=j1; un=d; }
+        }
+        a[n]=an; u[n]=un;
+      }
+      mind[n] = sq ? u[n]*u[n] : u[n];
+    }
+
+    // do not use most distant nOut elements in computation of centers
+    double thr=INFINITY; if( nOut>0 ) {
+      vectord m1(mind,mind+N); std::nth_element(m1.begin(),
+        m1.begin()+(N-nOut-1),m1.end()); thr=m1[N-nOut-1];
+    }
+
+    // recalculate means based on new assignment, discard small clusters
+    for( j=0; j<k; j++ ) cnt[j]=0;
+    for( i=0; i<N; i++ ) if( mind[i]<=thr ) cnt[a[i]]++;
+    for( k0=0, j=0; j<k; j++ ) map[j] = cnt[j]<minCl ? -1 : k0++;
+    for( changed=0, i=0; i<N; i++ ) {
+      double id = (mind[i]>thr || map[a[i]]<0) ? -1 : map[a[i]]+1;
+      if( id!=IDX[i] ) changed=1;
+      IDX[i]=id;
+    }
+    t++; if( nDg ) mexPrintf("%.*s%0*d",nDg,"\b\b\b\b\b\b\b\b\b\b",nDg,t);
+    if( k0==0 ) { k=1; return (changed && t<maxt) ? 2 : 1; }
+    std::copy(C,C+size_t(k)*p,C0.begin());
+    std::fill(C,C+size_t(k0)*p,0.0);
+    #ifdef USEOMP
+    #pragma omp parallel num_threads(nThreads)
+    #endif
+    {
+      vectord sums(size_t(k0)*p,0.0);
+      #ifdef USEOMP
+      #pragma omp for
+      #endif
+      for( int n=0; n<N; n++ ) if( IDX[n]>0 ) {
+        const T *x=X+n*size_t(p); double *c=&sums[(int(IDX[n])-1)*size_t(p)];
+        for( int j1=0; j1<p; j1++ ) c[j1]+=x[j1];
+      }
+      #ifdef USEOMP
+      #pragma omp critical
+      #endif
+      for( size_t j1=0; j1<size_t(k0)*p; j1++ ) C[j1]+=sums[j1];
+    }
+    double d1=0, d2=0; int j1=-1; for( j=0; j<k; j++ ) if( map[j]>=0 ) {
+      double *c=C+map[j]*size_t(p); for( i=0; i<p; i++ ) c[i]/=cnt[j];
+      double d=delta[map[j]]=dist(&C0[j*size_t(p)],c,p);
+      if( d>d1 ) { d2=d1; d1=d; j1=map[j]; } else if( d>d2 ) d2=d;
+    }
+
+    // update bounds (points whose center was discarded are recomputed), the
+    // hamerly bound moves by the largest shift among the other centers
+    for( i=0; i<N; i++ ) {
+      if( map[a[i]]<0 ) { full[i]=1; continue; }
+      a[i]=map[a[i]]; double *li=&l[i*Kl];
+      if( !elkan ) { li[0]-=(a[i]==j1 ? d2 : d1); continue; }
+      for( j=0; j<k; j++ ) if( map[j]>=0 ) li[map[j]]=li[j]-delta[map[j]];
+    }
+    k=k0;
+  }
+  return 0;
+}
+
+// [IDX,C,mind,t,reseed] = mexFunction( Xt, Ct, nOut, minCl, maxt, elkan,
+//   sq, nDg, nThreads, [IDX0] )
+// Xt is the transposed [pxN] data (double or single) and Ct the transposed
+// [pxk] initial centers. If sq the squared euclidean distance is used
+// otherwise the euclidean distance. If nDg>0 the iteration count is
+// displayed using nDg digits. IDX0 is the previous [Nx1] assignment (all
+// ones if not given). See kmeans() above for reseed.
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+  int N, p, k, nOut, minCl, maxt, nDg, nThreads, t=0, reseed=0;
+  bool elkan, sq; double *C, *IDX, *mind;
+  if( nrhs!=9 && nrhs!=10 ) mexErrMsgTxt("Nine or ten inputs required.");
+  p = (int) mxGetM(prhs[0]); N = (int) mxGetN(prhs[0]);
+  k = (int) mxGetN(prhs[1]);
+  nOut = (int) mxGetScalar(prhs[2]);
+  minCl = (int) mxGetScalar(prhs[3]);
+  maxt = (int) mxGetScalar(prhs[4]);
+  elkan = mxGetScalar(prhs[5])!=0;
+  sq = mxGetScalar(prhs[6])!=0;
+  nDg = std::min(10,(int) mxGetScalar(prhs[7]));
+  nThreads = (int) mxGetScalar(prhs[8]);
+  if( !mxIsDouble(prhs[1]) || int(mxGetM(prhs[1]))!=p || k<1 || N<1 )
+    mexErrMsgTxt("Ct must be a non-empty double [pxk] matrix.");
+  if( nOut<0 || nOut>=N ) mexErrMsgTxt("nOut must be in [0,N).");
+  if( nrhs==10 && (!mxIsDouble(prhs[9]) ||
+    int(mxGetNumberOfElements(prhs[9]))!=N) )
+    mexErrMsgTxt("IDX0 must be a double [Nx1] vector.");
+
+  // create outputs (C is cropped to the final number of clusters k)
+  plhs[1] = mxDuplicateArray(prhs[1]); C = mxGetPr(plhs[1]);
+  plhs[0] = mxCreateDoubleMatrix(N,1,mxREAL); IDX = mxGetPr(plhs[0]);
+  for( int i=0; i<N; i++ ) IDX[i] = nrhs==10 ? mxGetPr(prhs[9])[i] : 1;
+  plhs[2] = mxCreateDoubleMatrix(N,1,mxREAL); mind = mxGetPr(plhs[2]);
+  #define KMEANS(T) kmeans((T*) mxGetData(prhs[0]),N,p,C,k,nOut,minCl,\
+    maxt,elkan,sq,nDg,nThreads,IDX,mind,t)
+  if( mxIsDouble(prhs[0]) ) reseed=KMEANS(double);
+  else if( mxIsSingle(prhs[0]) ) reseed=KMEANS(float);
+  else mexErrMsgTxt("Xt must be of type double or single.");
+  #undef KMEANS
+  mxSetN(plhs[1],k);
+  plhs[3] = mxCreateDoubleScalar(t);
+  plhs[4] = mxCreateDoubleScalar(reseed);
+}
@@ -0,0 +1,290 @@
+/*******************************************************************************
+* Piotr's Computer Vision Matlab Toolbox      Version 3.50
+* Copyright 2014 Piotr Dollar.  [pdollar-at-gmail.com]
+* Licensed under the Simplified BSD License [see external/bsd.txt]
+*******************************************************************************/
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include <time.h>
+#include "mex.h"
+#include "../../channels/private/sse.hpp"
+#ifdef USEOMP
+#include <omp.h>
+#endif
+
+/*******************************************************************************
+* Uniform grid used to limit the radius search to a few cells. The grid spans
+* (up to) the three dimensions of data with the largest extent and the width
+* of each cell is at least radius. All points within radius of x (in the full
+* p dimensional space) lie in the 3^d cells adjacent to the cell containing x
+* (in the d chosen dimensions). Points are stored sorted by cell, and since
+* cells are ordered with the first chosen dimension varying fastest, the
+* candidates of each query form at most 3^(d-1) contiguous ranges of ids.
+*******************************************************************************/
+class Grid {
+public:
+  // choose grid dimensions and cell sizes given the bounding box of data
+  template<class T> void init( const T *data, int p, int n, double radius ) {
+    std::vector<double> lo(p,INFINITY), hi(p,-INFINITY), ext(p);
+    std::vector<int> order(p); int i, j, k, cap; _p=p; _n=n; _d=0;
+    for( i=0; i<n; i++ ) for( j=0; j<p; j++ ) {
+      double v=double(data[i*size_t(p)+j]); lo[j]=std::min(lo[j],v);
+      hi[j]=std::max(hi[j],v); }
+    for( j=0; j<p; j++ ) { ext[j]=n ? hi[j]-lo[j] : 0; order[j]=j; }
+    for( j=0; j<p; j++ ) for( k=j+1; k<p; k++ )
+      if( ext[order[k]]>ext[order[j]] ) std::swap(order[j],order[k]);
+    for( j=0; j<std::min(p,3); j++ ) if( ext[order[j]]>radius ) _d++;
+    cap = _d ? (int) ceil(pow(double(n),1.0/_d)) : 1; _nCells=1;
+    for( j=0; j<_d; j++ ) {
+      k=order[j]; _dims[j]=k; _mn[j]=lo[k];
+      _w[j]=std::max(radius,ext[k]/cap); _sz[j]=int(ext[k]/_w[j])+1;
+      _stride[j]=_nCells; _nCells*=_sz[j];
+    }
+    _cell.assign(n,-1); _start.resize(_nCells+1); _ids.resize(n);
+  }
+
+  // bucket points by cell (returns false if no point changed cell)
+  template<class T> bool build( const T *data ) {
+    int i, c; bool changed=false;
+    for( i=0; i<_n; i++ ) { c=cellId(data+i*size_t(_p));
+      if( c!=_cell[i] ) { _cell[i]=c; changed=true; } }
+    if( !changed ) return false;
+    std::fill(_start.begin(),_start.end(),0);
+    for( i=0; i<_n; i++ ) _start[_cell[i]+1]++;
+    for( c=0; c<_nCells; c++ ) _start[c+1]+=_start[c];
+    std::vector<int> pos(_start.begin(),_start.end()-1);
+    for( i=0; i<_n; i++ ) _ids[pos[_cell[i]]++]=i;
+    return true;
+  }
+
+  // get ranges [beg[r],end[r]) of ids() that contain all candidates of x
+  template<class T> int query( const T *x, int *beg, int *end ) const {
+    int k[3], lo[3], hi[3], j, c, r=0;
+    for( j=0; j<_d; j++ ) { k[j]=coord(x,j);
+      lo[j]=std::max(k[j]-1,0); hi[j]=std::min(k[j]+1,_sz[j]-1); }
+    if( _d==0 ) { beg[0]=0; end[0]=_n; return 1; }
+    for( int k2=(_d>2?lo[2]:0); k2<=(_d>2?hi[2]:0); k2++ )
+      for( int k1=(_d>1?lo[1]:0); k1<=(_d>1?hi[1]:0); k1++ ) {
+        c = k1*(_d>1?_stride[1]:0) + k2*(_d>2?_stride[2]:0);
+        beg[r]=_start[c+lo[0]]; end[r]=_start[c+hi[0]+1];
+        if( end[r]>beg[r] ) r++;
+      }
+    return r;
+  }
+
+  const int *ids() const { return &_ids[0]; }
+
+private:
+  int _p, _n, _d, _nCells, _dims[3], _sz[3], _stride[3];
+  double _mn[3], _w[3]; std::vector<int> _cell, _start, _ids;
+
+  template<class T> int coord( const T *x, int j ) const {
+    double v=(x[_dims[j]]-_mn[j])/_w[j];
+    return v<=0 ? 0 : (v>=_sz[j]-1 ? _sz[j]-1 : int(v));
+  }
+
+  template<class T> int cellId( const T *x ) const {
+    int c=0; for( int j=0; j<_d; j++ ) c+=coord(x,j)*_stride[j]; return c;
+  }
+};
+
+// squared distances d[k] from x to the c points k0+k of soa ([nxp] layout)
+template<class T> inline void distances( const T *soa, int n, int p,
+  const T *x, int k0, int c, T *d )
+{
+  for( int k=0; k<c; k++ ) d[k]=0;
+  for( int j=0; j<p; j++ ) { const T *s=soa+j*size_t(n)+k0, xj=x[j];
+    for( int k=0; k<c; k++ ) { T v=xj-s[k]; d[k]+=v*v; } }
+}
+
+// squared distances (single precision, 4 points at a time using SSE)
+template<> inline void distances( const float *soa, int n, int p,
+  const float *x, int k0, int c, float *d )
+{
+  int j, k=0; const float *s=soa+k0;
+  for( ; k+4<=c; k+=4 ) { __m128 a=SET(0.0f), v;
+    for( j=0; j<p; j++ ) {
+      v=SUB(SET(x[j]),LDu(s[j*size_t(n)+k])); a=ADD(a,MUL(v,v)); }
+    STRu(d[k],a);
+  }
+  for( ; k<c; k++ ) { float a=0, v;
+    for( j=0; j<p; j++ ) { v=x[j]-s[j*size_t(n)+k]; a+=v*v; } d[k]=a; }
+}
+
+// weighted sum of c values s[k] with weights w[k]
+template<class T> inline double wtdSum( const T *s, const T *w, int c ) {
+  double a=0; for( int k=0; k<c; k++ ) a+=w[k]*s[k]; return a;
+}
+
+// weighted sum (single precision, 4 values at a time using SSE)
+template<> inline double wtdSum( const float *s, const float *w, int c ) {
+  __m128 a=SET(0.0f); float b[4]; int k=0; double r=0;
+  for( ; k+4<=c; k+=4 ) a=ADD(a,MUL(LDu(w[k]),LDu(s[k])));
+  STRu(b[0],a); r=double(b[0])+b[1]+b[2]+b[3];
+  for( ; k<c; k++ ) r+=w[k]*s[k];
+  return r;
+}
+
+/*******************************************************************************
+* Calculates mean of all the points in data that lie on a sphere of
+* radius^2==radius2 centered on [1xp] vector x. soa contains the n points
+* in structure of arrays layout ([nxp], in the order given by the grid) so
+* that distances can be computed for multiple points at once. Only the
+* candidate points given by the grid are checked. If gamma>0 points are
+* weighted by exp(-gamma*dist^2) (Gaussian kernel truncated at radius),
+* otherwise all points within radius are weighted equally. mean contains
+* [1xp] result and return is number of points used for calc.
+*******************************************************************************/
+template<class T> int meanVec( const T *x, const T *soa, int p, int n,
+  const Grid &grid, double radius2, double gamma, double *mean )
+{
+  const int C=256; T d[C], w[C]; int j, k, k0, c, r, nr, m=0, mc;
+  int beg[9], end[9]; double wTot=0; nr=grid.query(x,beg,end);
+  for( j=0; j<p; j++ ) mean[j]=0;
+  for( r=0; r<nr; r++ ) for( k0=beg[r]; k0<end[r]; k0+=C ) {
+    c=std::min(C,end[r]-k0); distances(soa,n,p,x,k0,c,d); mc=0;
+    for( k=0; k<c; k++ ) if( d[k]<radius2 ) {
+      mc++; w[k] = gamma>0 ? T(exp(-gamma*d[k])) : T(1); wTot+=w[k];
+    } else w[k]=0;
+    m+=mc; if( !mc ) continue;
+    for( j=0; j<p; j++ ) mean[j]+=wtdSum(soa+j*size_t(n)+k0,w,c);
+  }
+  if( m && wTot>0 ) for( j=0; j<p; j++ ) mean[j]/=wTot;
+  return wTot>0 ? m : 0;
+}
+
+/* Squared euclidean distance between two vectors. */
+template<class T> double dist( const T *A, const T *B, int n ) {
+  double d=0.0; int i;
+  for(i=0; i<n; i++) d+=double(A[i]-B[i]) * double(A[i]-B[i]);
+  return d;
+}
+
+/* Print progress (at most once per second unless force is true). */
+void progress( int iter, int maxIter, time_t &last, bool force ) {
+  time_t t=time(NULL); if( !force && t<=last ) return; last=t;
+  mexPrintf( "\b\b\b\b\b\b\b\b%f", (float)iter/maxIter );
+  mexEvalString("drawnow;");
+}
+
+/*******************************************************************************
+* data      - p x n column matrix of data points
+* p         - dimension of data points
+* n         - number of data points
+* radius    - radius of search windo
+* rate      - gradient descent proportionality factor
+* maxIter   - max allowed number of iterations
+* blur      - specifies algorithm mode
+* gamma     - if >0 use Gaussian kernel exp(-gamma*dist^2) (else flat)
+* nThreads  - max number of computational threads to use
+* labels    - labels for each cluster
+* means     - output (final clusters, also used as current means)
+*******************************************************************************/
+template<class T> void meanShift( const T *data, int p, int n,
+  double radius, double rate, int maxIter, bool blur, double gamma,
+  int nThreads, double *labels, T *means )
+{
+  double radius2=radius*radius; int iter, i, j, k, r, nr, beg[9], end[9];
+  int delta=1, nLabels=1; std::vector<int> deltas(n,1), consolidated(n,0);
+  std::vector<T> meansNxt(data,data+size_t(p)*n), soa(size_t(p)*n);
+  T *meansCur=means; const T *data1; Grid grid; time_t last=time(NULL);
+  memcpy( meansCur, data, size_t(p)*n*sizeof(T) );
+  data1 = blur ? meansCur : data;
+  #ifdef USEOMP
+  nThreads = std::min(nThreads,omp_get_max_threads());
+  #endif
+
+  /* build index (if blur points are rebucketed, means stay within bounds) */
+  grid.init( data, p, n, radius ); grid.build( data );
+
+  /* main loop */
+  mexPrintf("Progress: 0.000000"); mexEvalString("drawnow;");
+  for(iter=0; iter<maxIter; iter++) {
+    /* (re)fill soa (data1 in grid order) */
+    delta = 0; if( blur && iter>0 ) grid.build( data1 );
+    if( blur || iter==0 ) { const int *ids=grid.ids();
+      for( k=0; k<n; k++ ) for( j=0; j<p; j++ )
+        soa[j*size_t(n)+k]=data1[ids[k]*size_t(p)+j]; }
+    #ifdef USEOMP
+    #pragma omp parallel num_threads(nThreads)
+    #endif
+    {
+      std::vector<double> mean(p); size_t o; int m;
+      #ifdef USEOMP
+      #pragma omp for schedule(dynamic,64) reduction(|:delta)
+      #endif
+      for( i=0; i<n; i++ ) {
+        if( !deltas[i] ) continue;
+        /* shift meansNxt in direction of mean (if m>0) */
+        o=i*size_t(p);
+        m=meanVec(meansCur+o,&soa[0],p,n,grid,radius2,gamma,&mean[0]);
+        if( m ) {
+          for( int j=0; j<p; j++ )
+            meansNxt[o+j] = T((1-rate)*meansCur[o+j] + rate*mean[j]);
+          if( dist(&meansNxt[o], meansCur+o, p)>0.001) delta=1;
+          else deltas[i]=0;
+        } else {
+          for( int j=0; j<p; j++ ) meansNxt[o+j] = meansCur[o+j];
+          deltas[i]=0;
+        }
+      }
+    }
+    progress( iter+1, maxIter, last, false );
+    memcpy( meansCur, &meansNxt[0], size_t(p)*n*sizeof(T) );
+    if(!delta) break;
+  }
+  progress( std::min(iter+1,maxIter), maxIter, last, true );
+  mexPrintf( "\n" );
+
+  /* Consolidate: assign all points that are within radius2 to same cluster. */
+  grid.init( meansCur, p, n, radius ); grid.build( meansCur );
+  const int *ids=grid.ids();
+  for( i=0; i<n; i++ ) labels[i]=0;
+  for( i=0; i<n; i++ ) if( !consolidated[i]) {
+    nr=grid.query(meansCur+i*size_t(p),beg,end);
+    for( r=0; r<nr; r++ ) for( k=beg[r]; k<end[r]; k++ ) {
+      j=ids[k]; if( consolidated[j] ) continue;
+      if( dist(meansCur+i*size_t(p), meansCur+j*size_t(p), p) < radius2) {
+        labels[j]=nLabels; consolidated[j]=1;
+      }
+    }
+    nLabels++;
+  }
+}
+
+/* see meanShift.m for usage info */
+void mexFunction( int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[] ) {
+  double radius, rate, gamma=0, *labels; int p, n, maxIter, nThreads;
+  bool blur=false; mxClassID id; void *data, *means;
+
+  /* Check inputs */
+  if(nrhs < 4) mexErrMsgTxt("At least four input arguments required.");
+  if(nlhs > 2) mexErrMsgTxt("Too many output arguments.");
+  if(nrhs>=5) blur = mxGetScalar(prhs[4])!=0;
+  if(nrhs>=6) gamma = mxGetScalar(prhs[5]);
+  nThreads = (nrhs>=7) ? (int) mxGetScalar(prhs[6]) : 100000;
+  id = mxGetClassID(prhs[0]);
+  if( id!=mxDOUBLE_CLASS && id!=mxSINGLE_CLASS )
+    mexErrMsgTxt("Data must be of type single or double.");
+
+  /* Get inputs */
+  data = mxGetData(prhs[0]);
+  radius = mxGetScalar(prhs[1]);
+  rate = mxGetScalar(prhs[2]);
+  maxIter = (int) mxGetScalar(prhs[3]);
+  p=(int) mxGetM(prhs[0]); n=(int) mxGetN(prhs[0]);
+
+  /* Create outputs */
+  plhs[0] = mxCreateNumericMatrix(n, 1, mxDOUBLE_CLASS, mxREAL);
+  plhs[1] = mxCreateNumericMatrix(p, n, id, mxREAL);
+  labels=mxGetPr(plhs[0]); means=mxGetData(plhs[1]);
+
+  /* Do the actual computations in a subroutine */
+  if( id==mxDOUBLE_CLASS ) meanShift( (double*) data, p, n, radius, rate,
+    maxIter, blur, gamma, nThreads, labels, (double*) means );
+  else meanShift( (float*) data, p, n, radius, rate,
+    maxIter, blur, gamma, nThreads, labels, (float*) means );
+}
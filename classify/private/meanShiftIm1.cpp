@@ -0,0 +1,176 @@
+/*******************************************************************************
+* Piotr's Computer Vision Matlab Toolbox      Version 3.50
+* Copyright 2014 Piotr Dollar.  [pdollar-at-gmail.com]
+* Licensed under the Simplified BSD License [see external/bsd.txt]
+*******************************************************************************/
+#include "mex.h"
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#ifdef USEOMP
+#include <omp.h>
+#endif
+
+/*******************************************************************************
+* Sparse bilateral grid over the joint spatial/range data. The image is cut
+* into square spatial cells of cs pixels, and within each cell the pixels are
+* grouped by range cell (of width .5 in the normalized range units of every
+* channel). Every non-empty group is stored as [count centroid] (centroid
+* has p dims). Groups of spatial cell c are entries start[c] to start[c+1]-1.
+*******************************************************************************/
+class BGrid
+{
+public:
+  BGrid( const double *data, int h, int w, int p, int cs, int nThreads )
+    : _h(h), _w(w), _p(p), _cs(cs)
+  {
+    int P=p-2; _gh=(h+cs-1)/cs; _gw=(w+cs-1)/cs; int nCells=_gh*_gw, c;
+    std::vector<int> cnt(nCells+1,0), ids(size_t(h)*w), keys(size_t(h)*w*P);
+    std::vector< std::vector<double> > ents(nCells);
+    for( int i=0; i<h*w; i++ ) {
+      for( int k=0; k<P; k++ ) keys[size_t(i)*P+k]=
+        int(floor(data[size_t(i)*p+k+2]*2));
+      cnt[cellId(i%h,i/h)+1]++;
+    }
+    for( c=0; c<nCells; c++ ) cnt[c+1]+=cnt[c];
+    std::vector<int> pos(cnt.begin(),cnt.end()-1);
+    for( int i=0; i<h*w; i++ ) ids[pos[cellId(i%h,i/h)]++]=i;
+    #ifdef USEOMP
+    #pragma omp parallel for num_threads(nThreads) schedule(dynamic)
+    #endif
+    for( int c1=0; c1<nCells; c1++ ) {
+      int *i0=&ids[cnt[c1]], *i1=&ids[cnt[c1+1]], *i, *j, k;
+      KeyLess less(&keys[0],P); std::sort(i0,i1,less);
+      for( i=i0; i<i1; i=j ) {
+        size_t e=ents[c1].size(); ents[c1].resize(e+p+1,0.0);
+        double *en=&ents[c1][e];
+        for( j=i; j<i1 && !less(*i,*j); j++ ) { en[0]++;
+          for( k=0; k<p; k++ ) en[k+1]+=data[size_t(*j)*p+k]; }
+        for( k=0; k<p; k++ ) en[k+1]/=en[0];
+      }
+    }
+    _start.resize(nCells+1,0); _start[0]=0;
+    for( c=0; c<nCells; c++ )
+      _start[c+1]=_start[c]+int(ents[c].size()/(p+1));
+    _ents.resize(size_t(_start[nCells])*(p+1));
+    for( c=0; c<nCells; c++ ) std::copy(ents[c].begin(),ents[c].end(),
+      _ents.begin()+size_t(_start[c])*(p+1));
+  }
+
+  // spatial cell range overlapping rows r0:r1 and cols c0:c1 (1-indexed)
+  void cells( int r0, int r1, int c0, int c1, int &gr0, int &gr1, int &gc0,
+    int &gc1 ) const
+  {
+    gr0=(r0-1)/_cs; gr1=(r1-1)/_cs; gc0=(c0-1)/_cs; gc1=(c1-1)/_cs;
+  }
+
+  // pointer to and number of entries of spatial cell (gr,gc)
+  const double *entries( int gr, int gc, int &n ) const {
+    int c=gr+gc*_gh; n=_start[c+1]-_start[c];
+    return &_ents[size_t(_start[c])*(_p+1)];
+  }
+
+private:
+  int _h, _w, _p, _cs, _gh, _gw; std::vector<int> _start;
+  std::vector<double> _ents;
+
+  int cellId( int r, int c ) const { return r/_cs+(c/_cs)*_gh; }
+
+  struct KeyLess {
+    const int *_k; int _P; KeyLess( const int *k, int P ) : _k(k), _P(P) {}
+    bool operator()( int a, int b ) const {
+      const int *ka=_k+size_t(a)*_P, *kb=_k+size_t(b)*_P;
+      return std::lexicographical_compare(ka,ka+_P,kb,kb+_P);
+    }
+  };
+};
+
+// accumulate point d (p dims) with weight n into mean m and total weight s
+// if it lies within the kernel centered at x (see meanShiftIm.m)
+inline void accum( const double *d, double n, const double *x, int p,
+  bool soft, double *m, double &s )
+{
+  int k; double D=0, v, wt;
+  for( k=0; k<p; k++ ) { v=d[k]-x[k]; D+=v*v; }
+  if( soft ) wt=n*exp(-D); else if( D<1 ) wt=n; else return;
+  s+=wt; for( k=0; k<p; k++ ) m[k]+=wt*d[k];
+}
+
+// run mean shift starting at x (p dims) until convergence, using either the
+// pixels of data ([pxhxw] layout) or the bilateral grid (if grid!=NULL)
+void shift( const double *data, const BGrid *grid, int h, int w, int p,
+  double sigSpt, int rad, bool soft, int maxIter, double minDel, double *x )
+{
+  std::vector<double> m(p); double diff=1, s, v; int it, k, r, c, n, i;
+  for( it=0; it<maxIter && diff>minDel; it++ ) {
+    // bounds of spatial window (1-indexed)
+    r=int(floor(x[0]*sigSpt+.5)); c=int(floor(x[1]*sigSpt+.5));
+    int r0=std::max(1,r-rad), r1=std::min(h,r+rad);
+    int c0=std::max(1,c-rad), c1=std::min(w,c+rad);
+    for( k=0; k<p; k++ ) m[k]=0;
+    s=0;
+    if( !grid ) {
+      for( c=c0; c<=c1; c++ ) for( r=r0; r<=r1; r++ )
+        accum(data+((r-1)+(c-1)*size_t(h))*p,1,x,p,soft,&m[0],s);
+    } else {
+      int gr0, gr1, gc0, gc1; grid->cells(r0,r1,c0,c1,gr0,gr1,gc0,gc1);
+      for( c=gc0; c<=gc1; c++ ) for( r=gr0; r<=gr1; r++ ) {
+        const double *e=grid->entries(r,c,n);
+        for( i=0; i<n; i++, e+=p+1 ) accum(e+1,e[0],x,p,soft,&m[0],s);
+      }
+    }
+    // update mean and check change in spatial location
+    for( diff=0, k=0; k<p; k++ ) {
+      v=m[k]/s; if( k<2 ) diff+=(x[k]-v)*(x[k]-v); x[k]=v; }
+  }
+}
+
+// M = mexFunction( X, sigSpt, sigRng, softFlag, maxIter, minDel, grid,
+//   nThreads )
+// X is a double [hxwxP] image. Returns normalized M [hxwx(P+2)], which must
+// be multiplied by sigSpt (first two channels) and sigRng (rest).
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+  int h, w, p, maxIter, nThreads, rad, i, k; double sigSpt, sigRng, minDel;
+  bool soft, useGrid; const double *X; double *M; const mwSize *dims;
+  if( nrhs!=8 ) mexErrMsgTxt("Eight input arguments required.");
+  if( !mxIsDouble(prhs[0]) ) mexErrMsgTxt("X must be of type double.");
+  dims = mxGetDimensions(prhs[0]); h=int(dims[0]); w=int(dims[1]);
+  p = (mxGetNumberOfDimensions(prhs[0])>2 ? int(dims[2]) : 1)+2;
+  X = mxGetPr(prhs[0]);
+  sigSpt = mxGetScalar(prhs[1]);
+  sigRng = mxGetScalar(prhs[2]);
+  soft = mxGetScalar(prhs[3])!=0;
+  maxIter = (int) mxGetScalar(prhs[4]);
+  minDel = mxGetScalar(prhs[5]);
+  useGrid = mxGetScalar(prhs[6])!=0;
+  nThreads = (int) mxGetScalar(prhs[7]);
+  if( sigSpt<1 || sigRng<=0 ) mexErrMsgTxt("Invalid sigSpt or sigRng.");
+  rad = int(soft ? 2*sigSpt : sigSpt);
+  #ifdef USEOMP
+  nThreads = std::min(nThreads,omp_get_max_threads());
+  #endif
+
+  // normalized joint spatial/range data ([pxhxw] layout)
+  std::vector<double> data(size_t(h)*w*p); size_t n=size_t(h)*w;
+  for( i=0; i<int(n); i++ ) {
+    double *d=&data[size_t(i)*p]; d[0]=(i%h+1)/sigSpt; d[1]=(i/h+1)/sigSpt;
+    for( k=2; k<p; k++ ) d[k]=X[i+(k-2)*n]/sigRng;
+  }
+  BGrid *grid = useGrid ? new BGrid(&data[0],h,w,p,
+    std::max(1,int(sigSpt)),nThreads) : NULL;
+
+  // run mean shift from every pixel
+  mwSize dimsM[3]={mwSize(h),mwSize(w),mwSize(p)};
+  plhs[0] = mxCreateNumericArray(3,dimsM,mxDOUBLE_CLASS,mxREAL);
+  M = mxGetPr(plhs[0]);
+  #ifdef USEOMP
+  #pragma omp parallel for num_threads(nThreads) schedule(dynamic,64)
+  #endif
+  for( int j=0; j<int(n); j++ ) {
+    std::vector<double> x(&data[size_t(j)*p],&data[size_t(j)*p]+p);
+    shift(&data[0],grid,h,w,p,sigSpt,rad,soft,maxIter,minDel,&x[0]);
+    for( int k1=0; k1<p; k1++ ) M[j+k1*n]=x[k1];
+  }
+  delete grid;
+}
@@ -0,0 +1,56 @@
+/*******************************************************************************
+* Piotr's Computer Vision Matlab Toolbox      Version 3.50
+* Copyright 2014 Piotr Dollar.  [pdollar-at-gmail.com]
+* Licensed under the Simplified BSD License [see external/bsd.txt]
+*******************************************************************************/
+#ifndef _PACKBLOCKS_HPP_
+#define _PACKBLOCKS_HPP_
+#include <stddef.h>
+#include <vector>
+
+// Data is stored feature-major ([NxF] Matlab array), so consecutive features
+// of a sample are N elements apart. During tree inference every node
+// touches a different column resulting in a cache miss per node. Instead,
+// the F1 features actually used by the model are repacked into row-major
+// blocks of B samples ([F1xB] per block), so that the features of a sample
+// are contiguous. Each block is packed once and all trees are applied
+// to it. Typical usage (per thread buffer buf of size B*F1):
+//  F1=packFids(fids,child,n,F,fids1,used); B=packBlockSize(F1,sizeof(T));
+//  for each block: packBlock(data,N,i0,n,used,F1,buf); ...use fids1...
+
+typedef unsigned int uint32;
+
+// Map the features used by n nodes (fids 0-indexed, child==0 indicates a
+// leaf, child may be NULL) to packed ids 0..F1-1. Stores the remapped ids in
+// fids1 (0 for leaves) and the original id of each packed feature in used.
+// Returns F1 or -1 if any feature id is out of range [0,F).
+inline int packFids( const uint32 *fids, const uint32 *child, size_t n,
+  int F, std::vector<uint32> &fids1, std::vector<uint32> &used )
+{
+  std::vector<int> fmap(F,-1); fids1.assign(n,0); used.clear();
+  for( size_t k=0; k<n; k++ ) {
+    uint32 f=fids[k]; if( child && !child[k] ) continue;
+    if( f>=uint32(F) ) return -1;
+    if( fmap[f]<0 ) { fmap[f]=int(used.size()); used.push_back(f); }
+    fids1[k]=fmap[f];
+  }
+  return int(used.size());
+}
+
+// Number of samples per block so that a packed block takes about 64KB.
+inline int packBlockSize( int F1, size_t bytes ) {
+  size_t B = (size_t(1)<<16)/(F1*bytes+1);
+  return B<16 ? 16 : (B>256 ? 256 : int(B));
+}
+
+// Pack samples [i0,i0+n) of feature-major data into row-major buf [F1xn].
+template<class T> void packBlock( const T *data, int N, int i0, int n,
+  const uint32 *used, int F1, T *buf )
+{
+  for( int f=0; f<F1; f++ ) {
+    const T *d=data+used[f]*size_t(N)+i0; T *b=buf+f;
+    for( int i=0; i<n; i++ ) b[i*size_t(F1)]=d[i];
+  }
+}
+
+#endif
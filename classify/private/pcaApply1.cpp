@@ -0,0 +1,112 @@
+/*******************************************************************************
+* Piotr's Computer Vision Matlab Toolbox      Version 3.50
+* Copyright 2014 Piotr Dollar.  [pdollar-at-gmail.com]
+* Licensed under the Simplified BSD License [see external/bsd.txt]
+*******************************************************************************/
+#include "mex.h"
+#include <vector>
+#include <algorithm>
+#include <emmintrin.h>
+#ifdef USEOMP
+#include <omp.h>
+#endif
+
+// samples are processed in blocks of NB, dimensions in chunks of DC
+static const int NB=64, DC=512;
+
+// load two consecutive values as doubles
+inline __m128d ld2( const double *x ) { return _mm_loadu_pd(x); }
+inline __m128d ld2( const float *x ) {
+  return _mm_cvtps_pd(_mm_castpd_ps(_mm_load_sd((const double*) x))); }
+
+// horizontal sum of the two values of a
+inline double hsum( __m128d a ) {
+  double b[2]; _mm_storeu_pd(b,a); return b[0]+b[1]; }
+
+// Y(j,t) += U(i0:i1-1,j)'*(X(i0:i1-1,t)-mu(i0:i1-1)) for 4 columns j of U
+// and 2 samples t (8 accumulators kept in SSE registers)
+template<class T> void project( const double *U, size_t D, const T *x0,
+  const T *x1, const double *mu, int i0, int i1, double *y0, double *y1 )
+{
+  __m128d a[4][2], u, m, v0, v1; int i, j;
+  for( j=0; j<4; j++ ) { a[j][0]=_mm_setzero_pd(); a[j][1]=a[j][0]; }
+  for( i=i0; i+2<=i1; i+=2 ) {
+    m=ld2(mu+i); v0=_mm_sub_pd(ld2(x0+i),m); v1=_mm_sub_pd(ld2(x1+i),m);
+    for( j=0; j<4; j++ ) { u=ld2(U+i+j*D);
+      a[j][0]=_mm_add_pd(a[j][0],_mm_mul_pd(u,v0));
+      a[j][1]=_mm_add_pd(a[j][1],_mm_mul_pd(u,v1)); }
+  }
+  for( j=0; j<4; j++ ) {
+    y0[j]+=hsum(a[j][0]); y1[j]+=hsum(a[j][1]);
+    if( i<i1 ) {
+      y0[j]+=U[i+j*D]*(x0[i]-mu[i]); y1[j]+=U[i+j*D]*(x1[i]-mu[i]); }
+  }
+}
+
+// Y=U'*(X-mu) and optionally Xhat=U*Y+mu and squared errors e=|Xhat-X|^2
+// and e0=|X-mu|^2 (U is [Dxk4] zero padded to multiple of 4 columns)
+template<class T> void pcaApply( const T *X, const double *U, const double *mu,
+  int D, int n, int k, int k4, int nThreads, T *Yk, T *Xhat, double &e,
+  double &e0 )
+{
+  int nBlk=(n+NB-1)/NB; e=e0=0;
+  #ifdef USEOMP
+  nThreads = std::min(nThreads,omp_get_max_threads());
+  #pragma omp parallel for num_threads(nThreads) schedule(dynamic) \
+    reduction(+:e,e0)
+  #endif
+  for( int b=0; b<nBlk; b++ ) {
+    int t0=b*NB, nb=std::min(NB,n-t0), t, j, i, i0;
+    std::vector<double> Y(size_t(k4)*NB,0.0), xh(Xhat ? D : 0);
+    // project samples of block (in chunks of DC dims so U stays in cache)
+    for( i0=0; i0<D; i0+=DC ) for( j=0; j<k4; j+=4 ) for( t=0; t<nb; t+=2 ) {
+      int t1=std::min(t+1,nb-1); const T *x0=X+size_t(t0+t)*D;
+      const T *x1=X+size_t(t0+t1)*D; double y1[4]={0,0,0,0};
+      double *y0=&Y[j+size_t(t)*k4];
+      project(U+size_t(j)*D,D,x0,x1,mu,i0,std::min(D,i0+DC),y0,
+        t1>t ? &Y[j+size_t(t1)*k4] : y1);
+    }
+    for( t=0; t<nb; t++ ) for( j=0; j<k; j++ )
+      Yk[j+size_t(t0+t)*k]=T(Y[j+size_t(t)*k4]);
+    if( !Xhat ) continue;
+    // reconstruct samples and accumulate errors
+    for( t=0; t<nb; t++ ) {
+      const double *y=&Y[size_t(t)*k4]; const T *x=X+size_t(t0+t)*D;
+      for( i=0; i<D; i++ ) xh[i]=mu[i];
+      for( j=0; j<k; j++ ) { const double *u=U+size_t(j)*D, yj=y[j];
+        for( i=0; i<D; i++ ) xh[i]+=u[i]*yj; }
+      T *xo=Xhat+size_t(t0+t)*D; for( i=0; i<D; i++ ) {
+        double d=xh[i]-x[i], d0=x[i]-mu[i]; e+=d*d; e0+=d0*d0; xo[i]=T(xh[i]);
+      }
+    }
+  }
+}
+
+// [Yk,Xhat,avsq] = mexFunction( X, Uk, mu, nThreads )
+// X is [Dxn] (single or double), Uk [Dxk] and mu [Dx1] double. Outputs are
+// of the same type as X, Xhat and avsq are only computed if requested.
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+  int D, n, k, k4, nThreads; double e, e0; mxClassID id;
+  if( nrhs!=4 ) mexErrMsgTxt("Four input arguments required.");
+  D = (int) mxGetM(prhs[0]); n = (int) mxGetN(prhs[0]);
+  k = (int) mxGetN(prhs[1]); nThreads = (int) mxGetScalar(prhs[3]);
+  id = mxGetClassID(prhs[0]);
+  if( id!=mxDOUBLE_CLASS && id!=mxSINGLE_CLASS )
+    mexErrMsgTxt("X must be of type single or double.");
+  if( !mxIsDouble(prhs[1]) || !mxIsDouble(prhs[2]) ||
+    int(mxGetM(prhs[1]))!=D || int(mxGetNumberOfElements(prhs[2]))!=D )
+    mexErrMsgTxt("Uk and mu must be double and match size of X.");
+
+  // zero pad U to a multiple of 4 columns
+  k4=(k+3)/4*4; std::vector<double> U(size_t(D)*k4,0.0);
+  std::copy(mxGetPr(prhs[1]),mxGetPr(prhs[1])+size_t(D)*k,U.begin());
+  plhs[0] = mxCreateNumericMatrix(k,n,id,mxREAL);
+  if( nlhs>1 ) plhs[1] = mxCreateNumericMatrix(D,n,id,mxREAL);
+  void *Xhat = nlhs>1 ? mxGetData(plhs[1]) : NULL;
+  #define APPLY(T) pcaApply((T*) mxGetData(prhs[0]),&U[0],mxGetPr(prhs[2]),\
+    D,n,k,k4,nThreads,(T*) mxGetData(plhs[0]),(T*) Xhat,e,e0)
+  if( id==mxDOUBLE_CLASS ) APPLY(double); else APPLY(float);
+  #undef APPLY
+  if( nlhs>2 ) plhs[2] = mxCreateDoubleScalar(e/e0);
+}
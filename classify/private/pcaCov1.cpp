@@ -0,0 +1,95 @@
+/*******************************************************************************
+* Piotr's Computer Vision Matlab Toolbox      Version 3.50
+* Copyright 2014 Piotr Dollar.  [pdollar-at-gmail.com]
+* Licensed under the Simplified BSD License [see external/bsd.txt]
+*******************************************************************************/
+#include "mex.h"
+#include <vector>
+#include <algorithm>
+#include <emmintrin.h>
+#ifdef USEOMP
+#include <omp.h>
+#endif
+
+// S is accumulated in [TxT] tiles over blocks of B samples
+static const int T=32, B=256;
+
+// copy samples t0:t0+nb-1 of X ([dxn]) minus K into blk ([dxB], zero padded
+// to a multiple of T rows) and add them to s
+template<class T1> void center( const T1 *X, const double *K, int d,
+  int t0, int nb, int dp, double *blk, double *s )
+{
+  for( int t=0; t<nb; t++ ) {
+    const T1 *x=X+size_t(t0+t)*d; double *b=blk+size_t(t)*dp;
+    for( int i=0; i<d; i++ ) { b[i]=x[i]-K[i]; s[i]+=b[i]; }
+    for( int i=d; i<dp; i++ ) b[i]=0;
+  }
+}
+
+// S(i0:i0+T-1,j0:j0+T-1) += blk(i0:,:)*blk(j0:,:)' (computed in [4x4]
+// blocks kept in SSE registers while looping over the nb samples)
+void tile( const double *blk, int nb, int dp, int i0, int j0, double *S ) {
+  for( int i=0; i<T; i+=4 ) for( int j=0; j<T; j+=4 ) {
+    __m128d a[4][2], x0, x1, y; int k;
+    for( k=0; k<4; k++ ) { a[k][0]=_mm_setzero_pd(); a[k][1]=a[k][0]; }
+    for( int t=0; t<nb; t++ ) {
+      const double *b=blk+size_t(t)*dp;
+      x0=_mm_loadu_pd(b+i0+i); x1=_mm_loadu_pd(b+i0+i+2);
+      for( k=0; k<4; k++ ) { y=_mm_set1_pd(b[j0+j+k]);
+        a[k][0]=_mm_add_pd(a[k][0],_mm_mul_pd(x0,y));
+        a[k][1]=_mm_add_pd(a[k][1],_mm_mul_pd(x1,y)); }
+    }
+    for( k=0; k<4; k++ ) { double *s=S+i+(j+k)*T;
+      _mm_storeu_pd(s,_mm_add_pd(_mm_loadu_pd(s),a[k][0]));
+      _mm_storeu_pd(s+2,_mm_add_pd(_mm_loadu_pd(s+2),a[k][1])); }
+  }
+}
+
+// s=sum(X-K,2) and S=(X-K)*(X-K)' computed in blocks of samples, the upper
+// triangle tiles of S are distributed over threads
+template<class T1> void pcaCov( const T1 *X, const double *K, int d, int n,
+  int nThreads, double *s, double *S )
+{
+  int dp=(d+T-1)/T*T, nt=dp/T, nTiles=nt*(nt+1)/2, t0, i, j;
+  std::vector<double> blk(size_t(dp)*B), acc(size_t(nTiles)*T*T,0.0);
+  std::vector<int> ti(nTiles), tj(nTiles);
+  for( i=0, t0=0; i<nt; i++ ) for( j=i; j<nt; j++, t0++ ) {
+    ti[t0]=i*T; tj[t0]=j*T; }
+  #ifdef USEOMP
+  nThreads = std::min(nThreads,omp_get_max_threads());
+  #endif
+  for( t0=0; t0<n; t0+=B ) {
+    int nb=std::min(B,n-t0); center(X,K,d,t0,nb,dp,&blk[0],s);
+    #ifdef USEOMP
+    #pragma omp parallel for num_threads(nThreads) schedule(dynamic)
+    #endif
+    for( int k=0; k<nTiles; k++ )
+      tile(&blk[0],nb,dp,ti[k],tj[k],&acc[size_t(k)*T*T]);
+  }
+  // copy tiles into S (mirroring the upper triangle)
+  for( int k=0; k<nTiles; k++ ) for( j=0; j<T; j++ ) for( i=0; i<T; i++ ) {
+    int r=ti[k]+i, c=tj[k]+j; if( r>=d || c>=d ) continue;
+    S[r+size_t(c)*d]=S[c+size_t(r)*d]=acc[size_t(k)*T*T+i+j*T];
+  }
+}
+
+// [s,S] = mexFunction( X, K, nThreads )
+// X is [dxn] (single or double) and K [dx1] double (shift). Returns the
+// [dx1] sum s and the [dxd] scatter matrix S of X-K (see pca.m).
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+  int d, n, nThreads; const double *K;
+  if( nrhs!=3 ) mexErrMsgTxt("Three input arguments required.");
+  d = (int) mxGetM(prhs[0]); n = (int) mxGetN(prhs[0]);
+  K = mxGetPr(prhs[1]); nThreads = (int) mxGetScalar(prhs[2]);
+  if( !mxIsDouble(prhs[1]) || int(mxGetNumberOfElements(prhs[1]))!=d )
+    mexErrMsgTxt("K must be a double [dx1] vector.");
+  plhs[0] = mxCreateDoubleMatrix(d,1,mxREAL);
+  plhs[1] = mxCreateDoubleMatrix(d,d,mxREAL);
+  double *s=mxGetPr(plhs[0]), *S=mxGetPr(plhs[1]);
+  if( mxIsDouble(prhs[0]) )
+    pcaCov((double*) mxGetData(prhs[0]),K,d,n,nThreads,s,S);
+  else if( mxIsSingle(prhs[0]) )
+    pcaCov((float*) mxGetData(prhs[0]),K,d,n,nThreads,s,S);
+  else mexErrMsgTxt("X must be of type single or double.");
+}
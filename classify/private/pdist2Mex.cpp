@@ -0,0 +1,187 @@
+/*******************************************************************************
+* Piotr's Computer Vision Matlab Toolbox      Version 3.50
+* Copyright 2014 Piotr Dollar.  [pdollar-at-gmail.com]
+* Licensed under the Simplified BSD License [see external/bsd.txt]
+*******************************************************************************/
+#include "mex.h"
+#include <math.h>
+#include <float.h>
+#include <vector>
+#include <algorithm>
+#include "../../channels/private/sse.hpp"
+#ifdef USEOMP
+#include <omp.h>
+#endif
+
+// metrics (in the order given by pdist2.m) and the per element operations
+// used to compute them (emd is L1 on cdfs, cosine is 1-dot of unit vectors)
+enum { SQEUCLIDEAN, EUCLIDEAN, L1, COSINE, EMD, CHISQ };
+enum { OP_SQ, OP_ABS, OP_DOT, OP_CHISQ };
+static const int BX=64, BY=256;
+
+template<int OP, class T> inline T op( T x, T y ) {
+  T v=x-y; switch( OP ) {
+    case OP_SQ: return v*v;
+    case OP_ABS: return fabs(v);
+    case OP_DOT: return x*y;
+    default: return v*v/(x+y+T(DBL_EPSILON));
+  }
+}
+
+template<int OP> inline __m128 op( __m128 x, __m128 y ) {
+  __m128 v=SUB(x,y); switch( OP ) {
+    case OP_SQ: return MUL(v,v);
+    case OP_ABS: return ANDNOT(SET(-0.0f),v);
+    case OP_DOT: return MUL(x,y);
+    default: return DIV(MUL(v,v),ADD(ADD(x,y),SET(float(DBL_EPSILON))));
+  }
+}
+
+// accumulate op over the p dims between y and the BX points of block xb
+// ([BXxp] layout) storing the results in t
+template<int OP, class T> void tile( const T *xb, const T *y, int p, T *t ) {
+  for( int i=0; i<BX; i+=8 ) {
+    T a[8]={0,0,0,0,0,0,0,0}; int j, l;
+    for( j=0; j<p; j++ ) { const T *x=xb+j*BX+i, yj=y[j];
+      for( l=0; l<8; l++ ) a[l]+=op<OP>(x[l],yj); }
+    for( l=0; l<8; l++ ) t[i+l]=a[l];
+  }
+}
+
+// accumulate op (single precision, 16 points at a time using SSE)
+template<int OP> void tile( const float *xb, const float *y, int p, float *t ) {
+  for( int i=0; i<BX; i+=16 ) {
+    __m128 a0=SET(0.0f), a1=a0, a2=a0, a3=a0, yj;
+    for( int j=0; j<p; j++ ) { const float *x=xb+j*BX+i; yj=SET(y[j]);
+      a0=ADD(a0,op<OP>(LDu(x[0]),yj)); a1=ADD(a1,op<OP>(LDu(x[4]),yj));
+      a2=ADD(a2,op<OP>(LDu(x[8]),yj)); a3=ADD(a3,op<OP>(LDu(x[12]),yj));
+    }
+    STRu(t[i],a0); STRu(t[i+4],a1); STRu(t[i+8],a2); STRu(t[i+12],a3);
+  }
+}
+
+// final distance given accumulated value (negative values and nans map to 0)
+template<class T> inline T post( T a, int metric ) {
+  switch( metric ) {
+    case EUCLIDEAN: a=sqrt(a); break;
+    case COSINE: a=1-a; break;
+    case CHISQ: a/=2; break;
+  }
+  return a>0 ? a : 0;
+}
+
+// copy x (n points with stride s between dims) to dst (stride d between
+// dims) applying the per metric transform (cdf for emd, unit norm for cosine)
+template<class T> void prep( const T *x, size_t s, int p, int metric, T *dst,
+  size_t d )
+{
+  int j; T a=0; for( j=0; j<p; j++ ) dst[j*d]=x[j*s];
+  if( metric==EMD ) for( j=1; j<p; j++ ) dst[j*d]+=dst[(j-1)*d];
+  if( metric!=COSINE ) return;
+  for( j=0; j<p; j++ ) a+=dst[j*d]*dst[j*d];
+  a=sqrt(a); for( j=0; j<p; j++ ) dst[j*d]/=a;
+}
+
+// Distances between rows of X [mxp] and Y [nxp] computed in [BXxBY] tiles.
+// If K==0 the full [mxn] matrix D is computed, otherwise D and ids are
+// [mxK] and contain the K nearest rows of Y for every row of X (sorted by
+// distance, ties broken by lower index).
+template<int OP, class T> void pdist( const T *X, const T *Y, int m, int n,
+  int p, int metric, int K, int nThreads, T *D, double *ids )
+{
+  typedef std::pair<T,int> dpair;
+  int nbx=(m+BX-1)/BX, nby=(n+BY-1)/BY;
+  std::vector<T> Xs(size_t(nbx)*BX*p,0), Yt(size_t(n)*p);
+  #ifdef USEOMP
+  nThreads = std::min(nThreads,omp_get_max_threads());
+  #pragma omp parallel num_threads(nThreads)
+  #endif
+  {
+    std::vector<T> t(BX); std::vector<dpair> heaps(K ? size_t(BX)*K : 0);
+    // copy X into blocks ([BXxp] layout) and Y into rows ([pxn] layout)
+    #ifdef USEOMP
+    #pragma omp for
+    #endif
+    for( int i=0; i<m; i++ )
+      prep(X+i,m,p,metric,&Xs[size_t(i/BX)*BX*p+i%BX],BX);
+    #ifdef USEOMP
+    #pragma omp for
+    #endif
+    for( int k=0; k<n; k++ ) prep(Y+k,n,p,metric,&Yt[size_t(k)*p],1);
+
+    // full distance matrix (every tile written by a single thread)
+    if( !K ) {
+      #ifdef USEOMP
+      #pragma omp for schedule(dynamic)
+      #endif
+      for( int b=0; b<nbx*nby; b++ ) {
+        int i0=(b%nbx)*BX, k0=(b/nbx)*BY, i1=std::min(m-i0,BX), k, i;
+        const T *xb=&Xs[size_t(i0)*p];
+        for( k=k0; k<std::min(n,k0+BY); k++ ) {
+          tile<OP>(xb,&Yt[size_t(k)*p],p,&t[0]); T *d=D+i0+size_t(k)*m;
+          for( i=0; i<i1; i++ ) d[i]=post(t[i],metric);
+        }
+      }
+    }
+
+    // K nearest neighbors (max-heap of the best K for every row of X)
+    if( K ) {
+      #ifdef USEOMP
+      #pragma omp for schedule(dynamic)
+      #endif
+      for( int b=0; b<nbx; b++ ) {
+        int i0=b*BX, i1=std::min(m-i0,BX), k, i, r;
+        const T *xb=&Xs[size_t(i0)*p];
+        for( k=0; k<n; k++ ) {
+          tile<OP>(xb,&Yt[size_t(k)*p],p,&t[0]);
+          for( i=0; i<i1; i++ ) {
+            dpair *h=&heaps[size_t(i)*K], v(post(t[i],metric),k);
+            if( k<K ) { h[k]=v; std::push_heap(h,h+k+1); }
+            else if( v<h[0] ) { std::pop_heap(h,h+K); h[K-1]=v;
+              std::push_heap(h,h+K); }
+          }
+        }
+        for( i=0; i<i1; i++ ) {
+          dpair *h=&heaps[size_t(i)*K]; std::sort_heap(h,h+K);
+          for( r=0; r<K; r++ ) { size_t o=i0+i+size_t(r)*m;
+            D[o]=h[r].first; ids[o]=h[r].second+1; }
+        }
+      }
+    }
+  }
+}
+
+// [D,ids] = mexFunction( X, Y, metric, K, nThreads )
+// X and Y must be of the same type (single or double), metric is an index
+// into {'sqeuclidean','euclidean','L1','cosine','emd','chisq'} (0-based)
+// and K is the number of nearest neighbors (if 0 the full D is computed).
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+  int m, n, p, metric, K, nThreads; mxClassID id;
+  if( nrhs!=5 ) mexErrMsgTxt("Five input arguments required.");
+  m = (int) mxGetM(prhs[0]); p = (int) mxGetN(prhs[0]);
+  n = (int) mxGetM(prhs[1]); id = mxGetClassID(prhs[0]);
+  metric = (int) mxGetScalar(prhs[2]);
+  K = (int) mxGetScalar(prhs[3]);
+  nThreads = (int) mxGetScalar(prhs[4]);
+  if( (id!=mxDOUBLE_CLASS && id!=mxSINGLE_CLASS) ||
+    mxGetClassID(prhs[1])!=id ) mexErrMsgTxt("X and Y must have same type.");
+  if( int(mxGetN(prhs[1]))!=p ) mexErrMsgTxt("X and Y must have same dim.");
+  if( metric<0 || metric>CHISQ ) mexErrMsgTxt("Unknown metric.");
+  K=std::max(0,std::min(K,n));
+
+  // create outputs and compute distances
+  plhs[0] = mxCreateNumericMatrix(m,K ? K : n,id,mxREAL);
+  plhs[1] = mxCreateDoubleMatrix(m,K,mxREAL);
+  void *D=mxGetData(plhs[0]); double *ids=mxGetPr(plhs[1]);
+  #define PDIST(OP,T) pdist<OP,T>((T*) mxGetData(prhs[0]),\
+    (T*) mxGetData(prhs[1]),m,n,p,metric,K,nThreads,(T*) D,ids)
+  #define PDISTT(OP) if( id==mxDOUBLE_CLASS ) PDIST(OP,double);\
+    else PDIST(OP,float);
+  if( metric==SQEUCLIDEAN || metric==EUCLIDEAN ) { PDISTT(OP_SQ); }
+  else if( metric==L1 || metric==EMD ) { PDISTT(OP_ABS); }
+  else if( metric==COSINE ) { PDISTT(OP_DOT); }
+  else { PDISTT(OP_CHISQ); }
+  #undef PDIST
+  #undef PDISTT
+}
@@ -0,0 +1,146 @@
+/*******************************************************************************
+* Piotr's Computer Vision Matlab Toolbox      Version 3.50
+* Copyright 2014 Piotr Dollar.  [pdollar-at-gmail.com]
+* Licensed under the Simplified BSD License [see external/bsd.txt]
+*******************************************************************************/
+#include "mex.h"
+#include <vector>
+#include <algorithm>
+#include <emmintrin.h>
+#ifdef USEOMP
+#include <omp.h>
+#endif
+
+// points of X are processed in blocks of BX (all basis centers per block)
+static const int BX=64;
+
+// squared distances between c and the BX points of block xb ([BXxd]
+// layout) stored in t (single precision, 16 points at a time)
+void tile( const float *xb, const float *c, int d, float *t ) {
+  for( int i=0; i<BX; i+=16 ) {
+    __m128 a[4], v, cj; int j, l;
+    for( l=0; l<4; l++ ) a[l]=_mm_setzero_ps();
+    for( j=0; j<d; j++ ) { const float *x=xb+j*BX+i; cj=_mm_set1_ps(c[j]);
+      for( l=0; l<4; l++ ) { v=_mm_sub_ps(_mm_loadu_ps(x+l*4),cj);
+        a[l]=_mm_add_ps(a[l],_mm_mul_ps(v,v)); }
+    }
+    for( l=0; l<4; l++ ) _mm_storeu_ps(t+i+l*4,a[l]);
+  }
+}
+
+// squared distances (double precision, 8 points at a time)
+void tile( const double *xb, const double *c, int d, double *t ) {
+  for( int i=0; i<BX; i+=8 ) {
+    __m128d a[4], v, cj; int j, l;
+    for( l=0; l<4; l++ ) a[l]=_mm_setzero_pd();
+    for( j=0; j<d; j++ ) { const double *x=xb+j*BX+i; cj=_mm_set1_pd(c[j]);
+      for( l=0; l<4; l++ ) { v=_mm_sub_pd(_mm_loadu_pd(x+l*2),cj);
+        a[l]=_mm_add_pd(a[l],_mm_mul_pd(v,v)); }
+    }
+    for( l=0; l<4; l++ ) _mm_storeu_pd(t+i+l*2,a[l]);
+  }
+}
+
+// t=exp(w*t) for BX values with w*t<=0 (single precision). The argument is
+// split as n*ln2+r with |r|<=ln2/2, exp(r) is approximated by its degree 7
+// Taylor polynomial and 2^n is built directly in the exponent bits.
+void expw( float *t, float w ) {
+  const float c[8]={1.f/5040,1.f/720,1.f/120,1.f/24,1.f/6,.5f,1,1};
+  __m128 x, r, p, nf, m; __m128i n; int i, k;
+  for( i=0; i<BX; i+=4 ) {
+    x=_mm_mul_ps(_mm_loadu_ps(t+i),_mm_set1_ps(w));
+    m=_mm_cmpgt_ps(x,_mm_set1_ps(-87.f)); x=_mm_max_ps(x,_mm_set1_ps(-87.f));
+    n=_mm_cvtps_epi32(_mm_mul_ps(x,_mm_set1_ps(1.44269504f)));
+    nf=_mm_cvtepi32_ps(n);
+    r=_mm_sub_ps(x,_mm_mul_ps(nf,_mm_set1_ps(.693359375f)));
+    r=_mm_add_ps(r,_mm_mul_ps(nf,_mm_set1_ps(2.12194440e-4f)));
+    for( p=_mm_set1_ps(c[0]), k=1; k<8; k++ )
+      p=_mm_add_ps(_mm_mul_ps(p,r),_mm_set1_ps(c[k]));
+    n=_mm_slli_epi32(_mm_add_epi32(n,_mm_set1_epi32(127)),23);
+    p=_mm_mul_ps(p,_mm_castsi128_ps(n)); _mm_storeu_ps(t+i,_mm_and_ps(p,m));
+  }
+}
+
+// t=exp(w*t) for BX values with w*t<=0 (double precision, degree 12)
+void expw( double *t, double w ) {
+  double c[13]; c[12]=1; for( int k=11; k>=0; k-- ) c[k]=c[k+1]/(12-k);
+  __m128d x, r, p, nf, m; __m128i n; int i, k;
+  for( i=0; i<BX; i+=2 ) {
+    x=_mm_mul_pd(_mm_loadu_pd(t+i),_mm_set1_pd(w));
+    m=_mm_cmpgt_pd(x,_mm_set1_pd(-708.0));
+    x=_mm_max_pd(x,_mm_set1_pd(-708.0));
+    n=_mm_cvtpd_epi32(_mm_mul_pd(x,_mm_set1_pd(1.4426950408889634)));
+    nf=_mm_cvtepi32_pd(n); r=_mm_sub_pd(x,_mm_mul_pd(nf,
+      _mm_set1_pd(6.93145751953125e-1)));
+    r=_mm_sub_pd(r,_mm_mul_pd(nf,_mm_set1_pd(1.42860682030941723212e-6)));
+    for( p=_mm_set1_pd(c[0]), k=1; k<13; k++ )
+      p=_mm_add_pd(_mm_mul_pd(p,r),_mm_set1_pd(c[k]));
+    n=_mm_add_epi32(n,_mm_set1_epi32(1023));
+    n=_mm_slli_epi64(_mm_shuffle_epi32(n,_MM_SHUFFLE(1,1,0,0)),52);
+    p=_mm_mul_pd(p,_mm_castsi128_pd(n)); _mm_storeu_pd(t+i,_mm_and_pd(p,m));
+  }
+}
+
+// Rbf features of the rows of X [Nxd] given centers mu [dxk] and weights w
+// ([1xk], feature j is exp(w(j)*|x-mu(j)|^2)), optionally followed by a
+// constant feature and normalized to sum to 1. If w==NULL the squared
+// distances are returned instead. Each block of BX rows of X is transposed,
+// and its distances, features and normalization are computed in one pass.
+template<class T> void rbf( const T *X, const double *mu, const double *w,
+  int N, int d, int k, bool constant, bool normalize, int nThreads, T *F )
+{
+  int nb=(N+BX-1)/BX, k1=k+(constant ? 1 : 0);
+  std::vector<T> C(size_t(k)*d); std::copy(mu,mu+size_t(k)*d,C.begin());
+  #ifdef USEOMP
+  nThreads = std::min(nThreads,omp_get_max_threads());
+  #pragma omp parallel num_threads(nThreads)
+  #endif
+  {
+    std::vector<T> xb(size_t(BX)*d,0), t(BX); std::vector<double> s(BX);
+    #ifdef USEOMP
+    #pragma omp for schedule(dynamic)
+    #endif
+    for( int b=0; b<nb; b++ ) {
+      int i0=b*BX, i1=std::min(N-i0,BX), i, j;
+      for( j=0; j<d; j++ ) for( i=0; i<i1; i++ )
+        xb[j*BX+i]=X[i0+i+size_t(j)*N];
+      for( i=0; i<BX; i++ ) s[i]=constant ? 1 : 0;
+      for( j=0; j<k; j++ ) {
+        tile(&xb[0],&C[size_t(j)*d],d,&t[0]); if( w ) expw(&t[0],T(w[j]));
+        T *f=F+i0+size_t(j)*N;
+        for( i=0; i<i1; i++ ) { f[i]=t[i]; s[i]+=t[i]; }
+      }
+      if( constant ) for( i=0; i<i1; i++ ) F[i0+i+size_t(k)*N]=1;
+      if( normalize ) for( j=0; j<k1; j++ ) {
+        T *f=F+i0+size_t(j)*N; for( i=0; i<i1; i++ ) f[i]=T(f[i]/s[i]); }
+    }
+  }
+}
+
+// F = mexFunction( X, mu, w, constant, normalize, nThreads )
+// X is [Nxd] (single or double), mu [dxk] and w [1xk] double (see rbf()
+// above, if w is empty squared distances are returned). F has class of X.
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+  int N, d, k, nThreads; bool constant, normalize; mxClassID id;
+  const double *mu, *w;
+  if( nrhs!=6 ) mexErrMsgTxt("Six input arguments required.");
+  N = (int) mxGetM(prhs[0]); d = (int) mxGetN(prhs[0]);
+  k = (int) mxGetN(prhs[1]); id = mxGetClassID(prhs[0]);
+  mu = mxGetPr(prhs[1]);
+  w = mxIsEmpty(prhs[2]) ? NULL : mxGetPr(prhs[2]);
+  constant = mxGetScalar(prhs[3])!=0;
+  normalize = mxGetScalar(prhs[4])!=0;
+  nThreads = (int) mxGetScalar(prhs[5]);
+  if( id!=mxDOUBLE_CLASS && id!=mxSINGLE_CLASS )
+    mexErrMsgTxt("X must be of type single or double.");
+  if( !mxIsDouble(prhs[1]) || int(mxGetM(prhs[1]))!=d )
+    mexErrMsgTxt("mu must be a double [dxk] matrix.");
+  if( w && (!mxIsDouble(prhs[2]) || int(mxGetNumberOfElements(prhs[2]))!=k))
+    mexErrMsgTxt("w must be a double [1xk] vector.");
+  plhs[0] = mxCreateNumericMatrix(N,k+(constant ? 1 : 0),id,mxREAL);
+  #define RBF(T) rbf((T*) mxGetData(prhs[0]),mu,w,N,d,k,constant,\
+    normalize,nThreads,(T*) mxGetData(plhs[0]))
+  if( id==mxDOUBLE_CLASS ) RBF(double); else RBF(float);
+  #undef RBF
+}
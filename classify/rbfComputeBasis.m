@@ -1,4 +1,4 @@
-function rbfBasis = rbfComputeBasis( X, k, cluster, scale, show )
+function rbfBasis = rbfComputeBasis( X, k, cluster, scale, show, nThreads )
 % Get locations and sizes of radial basis functions for use in rbf network.
 %
 % Radial basis function are a simple, fast method for universal function
@@ -27,7 +27,7 @@ function rbfBasis = rbfComputeBasis( X, k, cluster, scale, show )
 %  Christopher M. Bishop. "Neural Networks for Pattern Recognition"
 %
 % USAGE
-%  rbfBasis = rbfComputeBasis( X, k, [cluster], [scale], [show] )
+%  rbfBasis = rbfComputeBasis( X, k, [cluster], [scale], [show], [nThreads] )
 %
 % INPUTS
 %  X           - [N x d] N points of d dimensions each
@@ -38,6 +38,7 @@ function rbfBasis = rbfComputeBasis( X, k, cluster, scale, show )
 %                set larger for smoother results, too small -> bad interp
 %  show        - [0] will display results in figure(show)
 %                if show<0, assumes X is array Nxs^2 of N sxs patches
+%  nThreads    - [16] max number of computational threads to use
 %
 % OUTPUTS
 %  rfbBasis
@@ -62,6 +63,7 @@ if( nargin<2 || isempty(k)); error('k not specified'); end
 if( nargin<3 || isempty(cluster)); cluster=1;  end
 if( nargin<4 || isempty(scale)); scale=5;  end
 if( nargin<5 || isempty(show)); show=0;  end
+if( nargin<6 || isempty(nThreads)); nThreads=16;  end
 [N, d] = size(X);
 
 if( cluster )
@@ -81,7 +83,7 @@ else
 end
 
 %%% Set var to be equal to average distance of neareast neighbor.
-dist = pdist2( mu', mu' );
+dist = rbfComputeFtrs1( mu', double(mu), [], 0, 0, nThreads );
 dist = dist + realmax * eye( k );
 vars = min(dist)* scale;
 var  = mean(vars);
@@ -1,14 +1,20 @@
-function Xrbf = rbfComputeFtrs( X, rbfBasis )
+function Xrbf = rbfComputeFtrs( X, rbfBasis, nThreads )
 % Evaluate features of X given a set of radial basis functions.
 %
 % See rbfComputeBasis for discussion of rbfs and general usage.
 %
+% The distances, gaussian responses and normalization are computed by a
+% compiled kernel over blocks of rows of X (running on up to nThreads
+% threads), so no intermediate [N x k] distance matrix is created.
+% If X is single the features are computed in single precision.
+%
 % USAGE
-%  Xrbf = rbfComputeFtrs( X, rbfBasis )
+%  Xrbf = rbfComputeFtrs( X, rbfBasis, [nThreads] )
 %
 % INPUTS
 %  X         - [N x d] N points of d dimensions each
 %  rbfBasis  - rbfBasis struct (see rbfComputeBasis)
+%  nThreads  - [16] max number of computational threads to use
 %
 % OUTPUTS
 %  Xrbf      - [N x k] computed feature vectors
@@ -21,23 +27,15 @@ function Xrbf = rbfComputeFtrs( X, rbfBasis )
 % Copyright 2014 Piotr Dollar.  [pdollar-at-gmail.com]
 % Licensed under the Simplified BSD License [see external/bsd.txt]
 
-% compute distance to each basis function
-% mu=[k x d]; onesK=[k x 1]; Xi=[1 x d];
-Xrbf = pdist2(X,rbfBasis.mu','sqeuclidean');
+if( nargin<3 || isempty(nThreads) ), nThreads=16; end
 
-% compute gaussian response
+% gaussian response to each basis function is exp(w.*dist)
 if( rbfBasis.globalVar )
-  Xrbf = exp( Xrbf / (-2*rbfBasis.var) );
+  w = repmat( -1/(2*rbfBasis.var), 1, size(rbfBasis.mu,2) );
 else
-  Xrbf = exp( bsxfun(@rdivide, Xrbf, -2*rbfBasis.vars ) );
-end
-
-% add constant vector of ones as last feature
-if( rbfBasis.constant )
-  Xrbf(:,end+1) = 1;
+  w = -1./(2*rbfBasis.vars);
 end
 
-% normalize rbfs to sum to 1
-if( rbfBasis.normalize )
-  Xrbf = bsxfun(@rdivide, Xrbf, sum(Xrbf,2));
-end
+% compute (normalized) responses with constant feature appended
+Xrbf = rbfComputeFtrs1( X, double(rbfBasis.mu), double(w), ...
+  rbfBasis.constant, rbfBasis.normalize, nThreads );
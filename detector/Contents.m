@@ -7,6 +7,7 @@
 %   acfDemoCal   - Demo for aggregate channel features object detector on Caltech dataset.
 %   acfDemoInria - Demo for aggregate channel features object detector on Inria dataset.
 %   acfDetect    - Run aggregate channel features object detector on given image(s).
+%   acfDetectSeq - Run aggregate channel features object detector on video (pipelined).
 %   acfModify    - Modify aggregate channel features object detector.
 %   acfReadme    - Aggregate Channel Features Detector Overview.
 %   acfSweeps    - Parameter sweeps for ACF pedestrian detector.
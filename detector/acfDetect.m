@@ -1,4 +1,4 @@
-function bbs = acfDetect( I, detector, fileName )
+function [bbs,stats] = acfDetect( I, detector, fileName, roi )
 % Run aggregate channel features object detector on given image(s).
 %
 % The input 'I' can either be a single image (or filename) or a cell array
@@ -10,26 +10,67 @@ function bbs = acfDetect( I, detector, fileName )
 % bbs are saved to a comma separated text file and the output is set to
 % bbs=1. If saving detections for multiple images the output is stored in
 % the format [imgId x y w h score] and imgId is a one-indexed image id.
+% Finally, 'I' may also be a precomputed channel pyramid (the output of
+% chnsPyramid(I,detector.opts.pPyramid)), this allows the pyramid and
+% detection stages to run separately (see acfDetectSeq.m).
 %
 % A cell of detectors trained with the same channels can be specified,
 % detected bbs from each detector are concatenated. If using multiple
 % detectors and opts.pNms.separate=1 then each bb has a sixth element
-% bbType=j, where j is the j-th detector, see bbNms.m for details.
+% bbType=j, where j is the j-th detector, see bbNms.m for details. The
+% channel pyramid is computed only once and shared by all detectors, and
+% detectors with identical window size and stride are evaluated in a
+% single sweep over windows (so features for each window are fetched
+% once for all detectors). All detectors must have identical channel
+% settings (pPyramid.pChns and filters), otherwise an error is thrown.
+%
+% To bound memory use and the cost of nms (for example when using a low
+% cascThr on large crowded images), a detector can be set to keep only the
+% top 'maxDets' scoring detections at each scale, or, if 'maxDetsCell' is
+% nonzero, the top 'maxDets' detections in each maxDetsCell x maxDetsCell
+% cell (in pixels at each scale). See acfModify to set these options.
+%
+% Detection can optionally be restricted to a region of interest 'roi',
+% specified either as an [hxw] logical mask or as a [kx4] list of bbs. Only
+% windows whose centers fall inside the roi are evaluated. Moreover, the
+% channel pyramid is computed only over the roi plus a halo the size of
+% the (padded) model, so frames with small active regions are much cheaper
+% to process (each connected component of a mask is cropped separately,
+% crops that overlap are merged). Note that objects much larger than the
+% halo that are near the roi boundary may be detected less reliably (as the
+% channels outside the halo are replaced by padding). If 'I' is a cell
+% array 'roi' should be a cell array of the same length (with [] for
+% unrestricted detection).
+%
+% If a second output is requested, cascade statistics are also collected
+% (this adds a small overhead). For each detector j and each scale i,
+% stats(j).rej(t,i) is the number of windows rejected at tree t and
+% stats(j).rej(end,i) is the number of windows that passed every tree. If
+% multiple images are given the counts are summed over images (per scale
+% index). These statistics can be used to understand detector runtime and
+% to guide calibration of the soft cascade (see adaBoostCascade.m).
 %
 % USAGE
-%  bbs = acfDetect( I, detector, [fileName] )
+%  [bbs,stats] = acfDetect( I, detector, [fileName], [roi] )
 %
 % INPUTS
-%  I          - input image(s) of filename(s) of input image(s)
+%  I          - input image(s) of filename(s) of input image(s) or pyramid
 %  detector   - detector(s) trained via acfTrain
 %  fileName   - [] target filename (if specified return is 1)
+%  roi        - [] optional [hxw] logical mask or [kx4] bbs restricting
+%               detection
 %
 % OUTPUTS
 %  bbs        - [nx5] array of bounding boxes or cell array of bbs
+%  stats      - [nDetectors x 1] cascade statistics w the following fields
+%   .rej        - [nTrees+1 x nScales] rejection counts per tree and scale
+%   .nWins      - [nScales x 1] number of windows evaluated per scale
+%   .avgTrees   - [nScales x 1] average trees evaluated per window
 %
 % EXAMPLE
 %
-% See also acfTrain, acfModify, bbGt>loadAll, bbNms
+% See also acfTrain, acfModify, acfDetectSeq, adaBoostCascade, bbGt>loadAll,
+% bbNms
 %
 % Piotr's Computer Vision Matlab Toolbox      Version 3.40
 % Copyright 2014 Piotr Dollar.  [pdollar-at-gmail.com]
@@ -37,11 +78,16 @@ function bbs = acfDetect( I, detector, fileName )
 
 % run detector on every image
 if(nargin<3), fileName=''; end; multiple=iscell(I);
+if(nargin<4), roi=[]; end
+prof=nargout>1; if(prof), stats=cascStats(detector,{}); end
 if(~isempty(fileName) && exist(fileName,'file')), bbs=1; return; end
-if(~multiple), bbs=acfDetectImg(I,detector); else
-  n=length(I); bbs=cell(n,1);
-  parfor i=1:n, bbs{i}=acfDetectImg(I{i},detector); end
+if(~multiple), [bbs,rej]=acfDetectImg(I,detector,roi,prof); else
+  n=length(I); bbs=cell(n,1); if(isempty(roi)), roi=cell(n,1); end
+  rej=cell(n,1);
+  parfor i=1:n, [bbs{i},rej{i}]=acfDetectImg(I{i},detector,roi{i},prof); end
+  if(prof && n), for i=2:n, rej{1}=addRej(rej{1},rej{i}); end; rej=rej{1}; end
 end
+if(prof), stats=cascStats(detector,rej); end
 
 % write results to disk if fileName specified
 if(isempty(fileName)), return; end
@@ -54,16 +100,44 @@ dlmwrite(fileName,bbs); bbs=1;
 
 end
 
-function bbs = acfDetectImg( I, detector )
+function [bbs,rej] = acfDetectImg( I, detector, roi, prof )
 % Run trained sliding-window object detector on given image.
-Ds=detector; if(~iscell(Ds)), Ds={Ds}; end; nDs=length(Ds);
-opts=Ds{1}.opts; pPyramid=opts.pPyramid; pNms=opts.pNms;
-imreadf=opts.imreadf; imreadp=opts.imreadp;
+Ds=detector; if(~iscell(Ds)), Ds={Ds}; end; pNms=Ds{1}.opts.pNms;
+imreadf=Ds{1}.opts.imreadf; imreadp=Ds{1}.opts.imreadp;
+if(all(ischar(I))), I=feval(imreadf,I,imreadp{:}); end
+if(isempty(roi)), [bbs,rej]=acfDetectPyr(I,Ds,[],prof); else
+  if(isstruct(I)), error('roi cannot be used with precomputed pyramid.'); end
+  % detect separately in each (disjoint) crop surrounding the roi
+  [M,crops]=roiCrops(roi,[size(I,1) size(I,2)],Ds);
+  n=size(crops,1); bbs=cell(n,1); rej=cell(1,length(Ds));
+  for i=1:n, x0=crops(i,1); y0=crops(i,2); x1=crops(i,3); y1=crops(i,4);
+    [bb,rej1]=acfDetectPyr(I(y0:y1,x0:x1,:),Ds,M(y0:y1,x0:x1),prof);
+    if(~isempty(bb)), bb(:,1)=bb(:,1)+x0-1; bb(:,2)=bb(:,2)+y0-1; end
+    bbs{i}=bb; if(prof), rej=addRej(rej,rej1); end
+  end; bbs=cat(1,bbs{:}); if(isempty(bbs)), bbs=zeros(0,5); end
+end
+if(~isempty(pNms)), bbs=bbNms(bbs,pNms); end
+end
+
+function [bbs,rej] = acfDetectPyr( I, Ds, M, prof )
+% Compute channel pyramid and apply detectors (optionally within mask M).
+nDs=length(Ds); opts=Ds{1}.opts; pPyramid=opts.pPyramid; pNms=opts.pNms;
 shrink=pPyramid.pChns.shrink; pad=pPyramid.pad;
 separate=nDs>1 && isfield(pNms,'separate') && pNms.separate;
-% read image and compute features (including optionally applying filters)
-if(all(ischar(I))), I=feval(imreadf,I,imreadp{:}); end
-P=chnsPyramid(I,pPyramid); bbs=cell(P.nScales,nDs);
+% group detectors w same window size and stride (applied in one sweep)
+modelDs=zeros(nDs,2); key=zeros(nDs,5); cascThrs=zeros(nDs,1);
+for j=1:nDs, o=Ds{j}.opts; modelDs(j,:)=o.modelDs; maxDets=[inf 0];
+  if(isfield(o,'maxDets')), maxDets=[o.maxDets o.maxDetsCell]; end
+  key(j,:)=[o.modelDsPad o.stride maxDets]; cascThrs(j)=o.cascThr;
+  if(~isequal(o.pPyramid.pChns,pPyramid.pChns) || ...
+      ~isequal(isfield(o,'filters'),isfield(opts,'filters')) || ...
+      (isfield(o,'filters') && ~isequal(o.filters,opts.filters)))
+    error('All detectors must have identical channel settings.'); end
+end; [~,~,grp]=unique(key,'rows'); nGrp=max([grp; 0]);
+clfs=cellfun(@(D) D.clf,Ds,'UniformOutput',0);
+% compute features (including optionally applying filters)
+if(isstruct(I)), P=I; else P=chnsPyramid(I,pPyramid); end
+bbs=cell(P.nScales,nGrp); rej=cell(1,nDs);
 if(isfield(opts,'filters') && ~isempty(opts.filters)), shrink=shrink*2;
   for i=1:P.nScales, fs=opts.filters; C=repmat(P.data{i},[1 1 size(fs,4)]);
     for j=1:size(C,3), C(:,:,j)=conv2(C(:,:,j),fs(:,:,j),'same'); end
@@ -71,18 +145,77 @@ if(isfield(opts,'filters') && ~isempty(opts.filters)), shrink=shrink*2;
   end
 end
 % apply sliding window classifiers
-for i=1:P.nScales
-  for j=1:nDs, opts=Ds{j}.opts;
-    modelDsPad=opts.modelDsPad; modelDs=opts.modelDs;
-    bb = acfDetect1(P.data{i},Ds{j}.clf,shrink,...
-      modelDsPad(1),modelDsPad(2),opts.stride,opts.cascThr);
-    shift=(modelDsPad-modelDs)/2-pad;
-    bb(:,1)=(bb(:,1)+shift(2))/P.scaleshw(i,2);
-    bb(:,2)=(bb(:,2)+shift(1))/P.scaleshw(i,1);
-    bb(:,3)=modelDs(2)/P.scales(i);
-    bb(:,4)=modelDs(1)/P.scales(i);
-    if(separate), bb(:,6)=j; end; bbs{i,j}=bb;
+for i=1:P.nScales, Mi=maskChns(M,P.data{i},round(pad/shrink));
+  for g=1:nGrp, js=find(grp==g); kg=key(js(1),:);
+    modelDsPad=kg(1:2); stride=kg(3); maxDets=kg(4:5);
+    if(prof), [bb,r] = acfDetect1(P.data{i},clfs(js),shrink,modelDsPad(1),...
+        modelDsPad(2),stride,cascThrs(js),Mi,maxDets(1),maxDets(2));
+      for k=1:length(js), T=size(clfs{js(k)}.fids,2);
+        rej{js(k)}(:,i)=r([1:T end],k); end
+    else bb = acfDetect1(P.data{i},clfs(js),shrink,modelDsPad(1),...
+        modelDsPad(2),stride,cascThrs(js),Mi,maxDets(1),maxDets(2)); end
+    j=js(bb(:,6)); j=j(:); mDs=modelDs(j,:);
+    shift=[(modelDsPad(1)-mDs(:,1))/2-pad(1) (modelDsPad(2)-mDs(:,2))/2-pad(2)];
+    bb(:,1)=(bb(:,1)+shift(:,2))/P.scaleshw(i,2);
+    bb(:,2)=(bb(:,2)+shift(:,1))/P.scaleshw(i,1);
+    bb(:,3)=mDs(:,2)/P.scales(i);
+    bb(:,4)=mDs(:,1)/P.scales(i);
+    if(separate), bb(:,6)=j; else bb=bb(:,1:5); end; bbs{i,g}=bb;
   end
 end; bbs=cat(1,bbs{:});
-if(~isempty(pNms)), bbs=bbNms(bbs,pNms); end
+end
+
+function rej = addRej( rej, rej1 )
+% Sum cascade rejection counts (cells of [nTrees+1 x nScales] arrays).
+if(isempty(rej)), rej=rej1; return; end
+for j=1:length(rej1), a=rej{j}; b=rej1{j}; n=max(size(a,2),size(b,2));
+  if(isempty(a)), rej{j}=b; continue; end; if(isempty(b)), continue; end
+  a(:,end+1:n)=0; b(:,end+1:n)=0; rej{j}=a+b;
+end
+end
+
+function stats = cascStats( detector, rej )
+% Summarize cascade rejection counts for each detector.
+Ds=detector; if(~iscell(Ds)), Ds={Ds}; end; nDs=length(Ds);
+stats=struct('rej',cell(nDs,1),'nWins',[],'avgTrees',[]);
+for j=1:nDs, T=size(Ds{j}.clf.fids,2);
+  if(j>length(rej) || isempty(rej{j})), r=zeros(T+1,0); else r=rej{j}; end
+  n=sum(r,1)'; stats(j).rej=r; stats(j).nWins=n;
+  stats(j).avgTrees=(r'*[1:T T]')./max(n,1);
+end
+end
+
+function Mi = maskChns( M, chns, pad )
+% Resample image mask M to the (padded) resolution of chns.
+if(isempty(M)), Mi=[]; return; end
+sz=[size(chns,1) size(chns,2)]; sz0=sz-2*pad; Mi=zeros(sz,'uint8');
+r=pad(1)+1:pad(1)+sz0(1); c=pad(2)+1:pad(2)+sz0(2);
+Mi(r,c)=imResample(single(M),sz0)>0;
+end
+
+function [M,crops] = roiCrops( roi, sz, Ds )
+% Convert roi to [hxw] mask M and disjoint [x0 y0 x1 y1] crops with halo.
+halo=[0 0]; for j=1:length(Ds), halo=max(halo,Ds{j}.opts.modelDsPad); end
+if( islogical(roi) )
+  if(~isequal(size(roi),sz)), error('roi mask must be [hxw].'); end
+  % one bb per connected component of the mask (merged below if needed)
+  M=roi; bbs=regionprops(bwlabel(M),'BoundingBox');
+  bbs=reshape([bbs.BoundingBox],4,[])'; bbs(:,1:2)=bbs(:,1:2)+.5;
+elseif( isnumeric(roi) && ismatrix(roi) && size(roi,2)==4 )
+  bbs=double(roi); M=bbApply('toMask',bbs,sz(2),sz(1),1)>0;
+else
+  error('roi must be an [hxw] logical mask or a [kx4] list of bbs.');
+end
+crops=[bbs(:,1:2)-halo([2 1]) bbs(:,1:2)+bbs(:,3:4)+halo([2 1])-1];
+crops=round(crops); crops(:,1:2)=max(1,crops(:,1:2));
+crops(:,3)=min(sz(2),crops(:,3)); crops(:,4)=min(sz(1),crops(:,4));
+crops=crops(all(crops(:,1:2)<=crops(:,3:4),2),:);
+% greedily merge overlapping crops so each window center is in one crop
+merged=1; while( merged ), merged=0; n=size(crops,1);
+  for i=1:n-1, for j=i+1:n, a=crops(i,:); b=crops(j,:);
+      if(any(a(1:2)>b(3:4)) || any(b(1:2)>a(3:4))), continue; end
+      crops(i,:)=[min(a(1:2),b(1:2)) max(a(3:4),b(3:4))];
+      crops(j,:)=[]; merged=1; break;
+    end; if(merged), break; end; end
+end
 end
@@ -0,0 +1,129 @@
+function [bbs,info] = acfDetectSeq( fName, detector, varargin )
+% Run aggregate channel features object detector on every frame of a video.
+%
+% Processing each video frame consists of three stages: decoding the frame
+% (via seqIo), computing the channel pyramid (via chnsPyramid) and running
+% the sliding window detector followed by nms (via acfDetect). Instead of
+% running the stages strictly sequentially for every frame, acfDetectSeq()
+% runs them as a pipeline: while frame t is being detected, the pyramid of
+% frame t+1 is computed and frame t+2 is decoded. Decoding is done by the
+% client while the pyramid and detection stages run asynchronously on the
+% workers of the current parallel pool (using parfeval). Each stage has a
+% bounded queue holding at most 'qSize' frames, which bounds memory use.
+% Given enough workers, at steady state the throughput is determined by the
+% slowest stage. If no parallel pool is open (or if parallel=0) the stages
+% are run sequentially for each frame (useful for profiling the stages).
+% Note that pyramids are sent from the worker that computes them, via the
+% client, to the worker that runs detection, which adds some overhead.
+%
+% Timing info for each stage is also returned: for each stage, .time is the
+% average compute time per frame and .fps the corresponding max throughput
+% of that stage. Finally, .latency is the average time from the start of
+% decoding a frame to the end of its detection and .fps is the throughput
+% actually achieved by the pipeline.
+%
+% USAGE
+%  [bbs,info] = acfDetectSeq( fName, detector, [pPipe] )
+%
+% INPUTS
+%  fName      - seq file name (see seqIo)
+%  detector   - detector(s) trained via acfTrain (see acfDetect)
+%  pPipe      - additional params (struct or name/value pairs)
+%   .frames     - [] 0-indexed frames to process (if [] process all frames)
+%   .qSize      - [2] max number of frames queued in each stage
+%   .parallel   - [1] if true run pipelined (requires open parallel pool)
+%   .verbose    - [1] if true display timing information
+%
+% OUTPUTS
+%  bbs        - [nFrames x 1] cell array of bbs for each frame
+%  info       - timing information w the following fields
+%   .decode     - time per frame (.time) and throughput (.fps) of decoding
+%   .pyramid    - time per frame (.time) and throughput (.fps) of pyramid
+%   .detect     - time per frame (.time) and throughput (.fps) of detection
+%   .latency    - average latency per frame (in seconds)
+%   .fps        - overall throughput achieved (frames per second)
+%   .times      - [nFrames x 5] stage times, start and end time per frame
+%
+% EXAMPLE
+%  detector=load('models/AcfCaltech+Detector.mat'); detector=detector.detector;
+%  [bbs,info]=acfDetectSeq('../videos/peds30.seq',detector);
+%
+% See also acfDetect, seqIo, chnsPyramid, bbNms
+%
+% Piotr's Computer Vision Matlab Toolbox      Version 3.50
+% Copyright 2014 Piotr Dollar.  [pdollar-at-gmail.com]
+% Licensed under the Simplified BSD License [see external/bsd.txt]
+
+% get parameters and open video
+dfs={ 'frames',[], 'qSize',2, 'parallel',1, 'verbose',1 };
+[frames,qSize,usePar,verbose]=getPrmDflt(varargin,dfs,1);
+sr=seqIo(fName,'reader'); n=sr.getinfo(); n=n.numFrames;
+if(isempty(frames)), frames=0:n-1; end; n=length(frames);
+Ds=detector; if(~iscell(Ds)), Ds={Ds}; end; pPyramid=Ds{1}.opts.pPyramid;
+usePar=usePar && exist('gcp','file') && ~isempty(gcp('nocreate'));
+bbs=cell(n,1); times=zeros(n,5); start=tic; qSize=max(1,qSize);
+
+if( ~usePar )
+  % run stages sequentially for each frame
+  for i=1:n, times(i,4)=toc(start);
+    [I,times(i,1)]=decode(sr,frames(i));
+    [P,times(i,2)]=pyramid(I,pPyramid);
+    [bbs{i},times(i,3)]=detect(P,detector); times(i,5)=toc(start);
+  end
+else
+  % run stages as pipeline (qP/qD are queues of pyramid/detect futures)
+  qP={}; iP=[]; qD={}; iD=[]; k=0; nDone=0;
+  while( nDone<n ), busy=0;
+    % collect finished detections
+    for j=length(qD):-1:1, if(~strcmp(qD{j}.State,'finished')), continue; end
+      i=iD(j); [bbs{i},times(i,3)]=fetchOutputs(qD{j}); times(i,5)=toc(start);
+      qD(j)=[]; iD(j)=[]; nDone=nDone+1; busy=1;
+    end
+    % move finished pyramids (in order) to the detection stage
+    while( ~isempty(qP) && length(qD)<qSize && strcmp(qP{1}.State,'finished') )
+      i=iP(1); [P,times(i,2)]=fetchOutputs(qP{1}); qP(1)=[]; iP(1)=[];
+      qD{end+1}=parfeval(@detect,2,P,detector); %#ok<AGROW>
+      iD(end+1)=i; busy=1; %#ok<AGROW>
+    end
+    % decode next frame and submit it to the pyramid stage
+    if( k<n && length(qP)<qSize ), k=k+1; times(k,4)=toc(start);
+      [I,times(k,1)]=decode(sr,frames(k));
+      qP{end+1}=parfeval(@pyramid,2,I,pPyramid); %#ok<AGROW>
+      iP(end+1)=k; busy=1; %#ok<AGROW>
+    end
+    % if nothing changed wait (briefly) for the oldest unfinished future (if
+    % the oldest pyramid is done the detection queue is full, so wait on it)
+    if(busy), continue; end
+    F=qD; if(~isempty(qP) && ~strcmp(qP{1}.State,'finished')), F=qP; end
+    wait(F{1},'finished',.005);
+  end
+end
+sr.close(); total=toc(start);
+
+% create output timing info
+nms={'decode','pyramid','detect'}; info=struct();
+for j=1:3, t=mean(times(:,j)); info.(nms{j})=struct('time',t,'fps',1/t); end
+info.latency=mean(times(:,5)-times(:,4)); info.fps=n/total; info.times=times;
+if( verbose )
+  fprintf('decode=%.1fms pyramid=%.1fms detect=%.1fms (per frame)\n',...
+    info.decode.time*1e3,info.pyramid.time*1e3,info.detect.time*1e3);
+  fprintf('latency=%.1fms throughput=%.1ffps (frames=%i)\n',...
+    info.latency*1e3,info.fps,n);
+end
+
+end
+
+function [I,t] = decode( sr, frame )
+% Decode single frame.
+t=tic; sr.seek(frame); I=sr.getframe(); t=toc(t);
+end
+
+function [P,t] = pyramid( I, pPyramid )
+% Compute channel pyramid for single frame.
+t=tic; P=chnsPyramid(I,pPyramid); t=toc(t);
+end
+
+function [bbs,t] = detect( P, detector )
+% Apply detector(s) and nms to precomputed pyramid.
+t=tic; bbs=acfDetect(P,detector); t=toc(t);
+end
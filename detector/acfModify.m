@@ -10,9 +10,13 @@ function detector = acfModify( detector, varargin )
 % The parameters 'nPerOct', 'nOctUp', 'nApprox', 'lambdas', 'pad', 'minDs'
 % modify the channel feature pyramid created (see help of chnsPyramid.m for
 % more details) and primarily control the scales used. The parameters
-% 'pNms', 'stride', 'cascThr' and 'cascCal' modify the detector behavior
-% (see help of acfTrain.m for more details). Finally, 'rescale' can be
-% used to rescale the trained detector (this change is irreversible).
+% 'pNms', 'stride', 'cascThr', 'cascCal', 'maxDets' and 'maxDetsCell'
+% modify the detector behavior (see help of acfTrain.m for more details).
+% If the soft cascade was calibrated (see adaBoostCascade.m) the per-tree
+% rejection thresholds are relative to the cascThr used for calibration,
+% hence cascThr should not be changed afterwards (a warning is issued).
+% Finally, 'rescale' can be used to rescale the trained detector (this
+% change is irreversible).
 %
 % USAGE
 %  detector = acfModify( detector, pModify )
@@ -30,6 +34,8 @@ function detector = acfModify( detector, varargin )
 %   .stride     - [] spatial stride between detection windows
 %   .cascThr    - [] constant cascade threshold (affects speed/accuracy)
 %   .cascCal    - [] cascade calibration (affects speed/accuracy)
+%   .maxDets    - [] max detections kept per scale (or per cell)
+%   .maxDetsCell- [] cell size for maxDets (if 0 maxDets is per scale)
 %   .rescale    - [] rescale entire detector by given ratio
 %
 % OUTPUTS
@@ -45,11 +51,14 @@ function detector = acfModify( detector, varargin )
 
 % get parameters (and copy to detector and pPyramid structs)
 opts=detector.opts; p=opts.pPyramid;
+if(~isfield(opts,'maxDets')), opts.maxDets=inf; opts.maxDetsCell=0; end
 dfs={ 'nPerOct',p.nPerOct, 'nOctUp',p.nOctUp, 'nApprox',p.nApprox, ...
   'lambdas',p.lambdas, 'pad',p.pad, 'minDs',p.minDs, 'pNms',opts.pNms, ...
-  'stride',opts.stride,'cascThr',opts.cascThr,'cascCal',0,'rescale',1 };
+  'stride',opts.stride,'cascThr',opts.cascThr,'cascCal',0,'rescale',1, ...
+  'maxDets',opts.maxDets, 'maxDetsCell',opts.maxDetsCell };
 [p.nPerOct,p.nOctUp,p.nApprox,p.lambdas,p.pad,p.minDs,opts.pNms,...
-  opts.stride,opts.cascThr,cascCal,rescale] = getPrmDflt(varargin,dfs,1);
+  opts.stride,opts.cascThr,cascCal,rescale,opts.maxDets,...
+  opts.maxDetsCell] = getPrmDflt(varargin,dfs,1);
 
 % finalize pPyramid and opts
 p.complete=0; p.pChns.complete=0; p=chnsPyramid([],p); p=p.pPyramid;
@@ -58,6 +67,8 @@ opts.stride=max(1,round(opts.stride/shrink))*shrink;
 opts.pPyramid=p; detector.opts=opts;
 
 % calibrate and rescale detector
+if( isfield(detector.clf,'cascThr') && opts.cascThr~=detector.clf.cascThr )
+  warning('Cascade was calibrated for cascThr=%g.',detector.clf.cascThr); end
 detector.clf.hs = detector.clf.hs+cascCal;
 if(rescale~=1), detector=detectorRescale(detector,rescale); end
 
@@ -31,12 +31,18 @@ function detector = acfTrain( varargin )
 % and calibration used for the constant soft cascades. Typically, set
 % 'cascThr' to -1 and adjust 'cascCal' until the desired recall is reached
 % (setting 'cascCal' shifts the final scores output by the detector by the
-% given amount). Training alternates between sampling (bootstrapping) and
-% training an AdaBoost classifier (clf). 'nWeak' determines the number of
-% training stages and number of trees after each stage, e.g. nWeak=[32 128
-% 512 2048] defines four stages with the final clf having 2048 trees.
+% given amount). 'maxDets' bounds the number of detections kept at each
+% scale (or in each 'maxDetsCell' sized spatial cell if maxDetsCell>0),
+% using a heap to keep only the top scoring windows during detection.
+% Training alternates between sampling (bootstrapping) and training an
+% AdaBoost classifier (clf). 'nWeak' determines the number of training
+% stages and number of trees after each stage, e.g. nWeak=[32 128 512
+% 2048] defines four stages with the final clf having 2048 trees.
 % 'pBoost' specifies parameters for AdaBoost, and 'pBoost.pTree' are the
-% decision tree parameters, see adaBoostTrain.m for details. Finally,
+% decision tree parameters, see adaBoostTrain.m for details. If 'pCasc' is
+% specified the soft cascade of the final clf is calibrated (trees are
+% reordered and per-tree rejection thresholds are set) using the training
+% data of the final stage, see adaBoostCascade.m for details. Finally,
 % 'seed' is the random seed used and makes results reproducible and 'name'
 % defines the location for storing the detector and log file.
 %
@@ -78,8 +84,11 @@ function detector = acfTrain( varargin )
 %   .stride     - [4] spatial stride between detection windows
 %   .cascThr    - [-1] constant cascade threshold (affects speed/accuracy)
 %   .cascCal    - [.005] cascade calibration (affects speed/accuracy)
+%   .maxDets    - [inf] max number of detections kept per scale (or cell)
+%   .maxDetsCell- [0] if >0 maxDets applies per cell of given size
 %   .nWeak      - [128] vector defining number weak clfs per stage
 %   .pBoost     - [..] parameters for boosting (see adaBoostTrain.m)
+%   .pCasc      - [] params for cascade calibration (see adaBoostCascade)
 %   .seed       - [0] seed for random stream (for reproducibility)
 %   .name       - [''] name to prepend to clf and log filenames
 %   (2) training data location and amount:
@@ -179,6 +188,15 @@ for stage = 0:numel(opts.nWeak)-1
   detector.clf = adaBoostTrain(X0,X1,detector.opts.pBoost);
   detector.clf.hs = detector.clf.hs + opts.cascCal;
   
+  % optionally calibrate soft cascade of final clf
+  if( stage==numel(opts.nWeak)-1 && ~isempty(opts.pCasc) )
+    pCasc=opts.pCasc; pCasc.thr=opts.cascThr;
+    [detector.clf,info]=adaBoostCascade(detector.clf,X0,X1,pCasc);
+    fprintf('Calibrated cascade: trees per neg %.1f->%.1f',...
+      info.trees0,info.trees1);
+    fprintf(' recall %.4f->%.4f\n',info.recall0,info.recall1);
+  end
+  
   % update log
   fprintf('Done training stage %i (time=%.0fs).\n',...
     stage,etime(clock,startStage)); diary('off');
@@ -199,10 +217,11 @@ function opts = initializeOpts( varargin )
 dfs= { 'pPyramid',{}, 'filters',[], ...
   'modelDs',[100 41], 'modelDsPad',[128 64], ...
   'pNms',struct(), 'stride',4, 'cascThr',-1, 'cascCal',.005, ...
+  'maxDets',inf, 'maxDetsCell',0, ...
   'nWeak',128, 'pBoost', {}, 'seed',0, 'name','', 'posGtDir','', ...
   'posImgDir','', 'negImgDir','', 'posWinDir','', 'negWinDir','', ...
   'imreadf',@imread, 'imreadp',{}, 'pLoad',{}, 'nPos',inf, 'nNeg',5000, ...
-  'nPerNeg',25, 'nAccNeg',10000, 'pJitter',{}, 'winsSave',0 };
+  'nPerNeg',25, 'nAccNeg',10000, 'pJitter',{}, 'winsSave',0, 'pCasc',[] };
 opts = getPrmDflt(varargin,dfs,1);
 % fill in remaining parameters
 p=chnsPyramid([],opts.pPyramid); p=p.pPyramid;
@@ -219,6 +238,7 @@ opts.pBoost=getPrmDflt(opts.pBoost,dfs,1);
 dfs={'nBins',256,'maxDepth',2,'minWeight',.01,'fracFtrs',1,'nThreads',16};
 opts.pBoost.pTree=getPrmDflt(opts.pBoost.pTree,dfs,1);
 opts.pLoad=getPrmDflt(opts.pLoad,{'squarify',{0,1}},-1);
+if(~isempty(opts.pCasc)), opts.pCasc=getPrmDflt(opts.pCasc,{},-1); end
 opts.pLoad.squarify{2}=opts.modelDs(2)/opts.modelDs(1);
 end
 
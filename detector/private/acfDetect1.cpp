@@ -6,6 +6,7 @@
 #include "mex.h"
 #include <vector>
 #include <cmath>
+#include <algorithm>
 using namespace std;
 
 typedef unsigned int uint32;
@@ -18,36 +19,146 @@ inline void getChild( float *chns1, uint32 *cids, uint32 *fids,
   k0=k+=k0*2; k+=offset;
 }
 
+// detection (window location, score and model id)
+struct Det { float h; int r, c, m; };
+inline bool detCmp( const Det &a, const Det &b ) { return a.h>b.h; }
+
+// add detection to bounded min-heap storing (at most) the top k detections
+inline void heapPush( vector<Det> &heap, const Det &d, int k )
+{
+  if( (int) heap.size()<k ) {
+    heap.push_back(d); push_heap(heap.begin(),heap.end(),detCmp);
+  } else if( d.h>heap.front().h ) {
+    pop_heap(heap.begin(),heap.end(),detCmp); heap.back()=d;
+    push_heap(heap.begin(),heap.end(),detCmp);
+  }
+}
+
+// tree model (boosted clf trained by adaBoostTrain) applied in the sweep
+struct Model {
+  float *thrs, *hs; uint32 *fids, *child;
+  int treeDepth, nTreeNodes, nTrees; float cascThr;
+};
+
+void getModel( const mxArray *trees, float cascThr, Model &M )
+{
+  M.thrs = (float*) mxGetData(mxGetField(trees,0,"thrs"));
+  M.hs = (float*) mxGetData(mxGetField(trees,0,"hs"));
+  M.fids = (uint32*) mxGetData(mxGetField(trees,0,"fids"));
+  M.child = (uint32*) mxGetData(mxGetField(trees,0,"child"));
+  M.treeDepth = mxGetField(trees,0,"treeDepth")==NULL ? 0 :
+    (int) mxGetScalar(mxGetField(trees,0,"treeDepth"));
+  const mwSize *fidsSize = mxGetDimensions(mxGetField(trees,0,"fids"));
+  M.nTreeNodes = (int) fidsSize[0];
+  M.nTrees = (int) fidsSize[1];
+  M.cascThr = cascThr;
+}
+
+// apply single model to the window with top-left corner at chns1 (on exit
+// t is the index of the tree at which the window was rejected, if any)
+float applyModel( const Model &M, float *chns1, uint32 *cids, int &t )
+{
+  float h=0; const float cascThr=M.cascThr;
+  const int treeDepth=M.treeDepth, nTreeNodes=M.nTreeNodes, nTrees=M.nTrees;
+  float *thrs=M.thrs, *hs=M.hs; uint32 *fids=M.fids, *child=M.child;
+  if( treeDepth==1 ) {
+    // specialized case for treeDepth==1
+    for( t = 0; t < nTrees; t++ ) {
+      uint32 offset=t*nTreeNodes, k=offset, k0=0;
+      getChild(chns1,cids,fids,thrs,offset,k0,k);
+      h += hs[k]; if( h<=cascThr ) break;
+    }
+  } else if( treeDepth==2 ) {
+    // specialized case for treeDepth==2
+    for( t = 0; t < nTrees; t++ ) {
+      uint32 offset=t*nTreeNodes, k=offset, k0=0;
+      getChild(chns1,cids,fids,thrs,offset,k0,k);
+      getChild(chns1,cids,fids,thrs,offset,k0,k);
+      h += hs[k]; if( h<=cascThr ) break;
+    }
+  } else if( treeDepth>2) {
+    // specialized case for treeDepth>2
+    for( t = 0; t < nTrees; t++ ) {
+      uint32 offset=t*nTreeNodes, k=offset, k0=0;
+      for( int i=0; i<treeDepth; i++ )
+        getChild(chns1,cids,fids,thrs,offset,k0,k);
+      h += hs[k]; if( h<=cascThr ) break;
+    }
+  } else {
+    // general case (variable tree depth)
+    for( t = 0; t < nTrees; t++ ) {
+      uint32 offset=t*nTreeNodes, k=offset, k0=k;
+      while( child[k] ) {
+        float ftr = chns1[cids[fids[k]]];
+        k = (ftr<thrs[k]) ? 1 : 0;
+        k0 = k = child[k0]-k+offset;
+      }
+      h += hs[k]; if( h<=cascThr ) break;
+    }
+  }
+  return h;
+}
+
+// [bbs,rej] = mexFunction(chns,trees,shrink,modelHt,modelWd,stride,
+//   cascThr,[mask],[maxDets],[cellSz])
+// If trees is a cell array of nModels models (that share the same channels
+// and window size) all models are applied in a single sweep over windows
+// and bbs contains a sixth column with the (1-indexed) model id. If the
+// optional output rej is requested it is set to a [maxTrees+1 x nModels]
+// array of cascade statistics: rej(t,j) is the number of windows rejected
+// by model j at tree t and rej(end,j) is the number of accepted windows.
+// If maxDets>0 only the top maxDets scoring detections (per model) are kept
+// using a bounded heap. If cellSz>0 the windows are further divided into
+// spatial cells of cellSz x cellSz pixels (based on the window's top-left
+// corner) and the top maxDets detections are kept per cell (and model).
 void mexFunction( int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[] )
 {
   // get inputs
   float *chns = (float*) mxGetData(prhs[0]);
-  mxArray *trees = (mxArray*) prhs[1];
+  const mxArray *trees = prhs[1];
   const int shrink = (int) mxGetScalar(prhs[2]);
   const int modelHt = (int) mxGetScalar(prhs[3]);
   const int modelWd = (int) mxGetScalar(prhs[4]);
   const int stride = (int) mxGetScalar(prhs[5]);
-  const float cascThr = (float) mxGetScalar(prhs[6]);
-
-  // extract relevant fields from trees
-  float *thrs = (float*) mxGetData(mxGetField(trees,0,"thrs"));
-  float *hs = (float*) mxGetData(mxGetField(trees,0,"hs"));
-  uint32 *fids = (uint32*) mxGetData(mxGetField(trees,0,"fids"));
-  uint32 *child = (uint32*) mxGetData(mxGetField(trees,0,"child"));
-  const int treeDepth = mxGetField(trees,0,"treeDepth")==NULL ? 0 :
-    (int) mxGetScalar(mxGetField(trees,0,"treeDepth"));
+  const bool hasMask = nrhs>7 && !mxIsEmpty(prhs[7]);
+  unsigned char *mask = hasMask ? (unsigned char*) mxGetData(prhs[7]) : 0;
+  const double maxDets0 = nrhs>8 ? mxGetScalar(prhs[8]) : 0;
+  const int maxDets = (maxDets0>0 && maxDets0<1e9) ? (int) maxDets0 : 0;
+  const int cellSz = (nrhs>9 && maxDets) ? (int) mxGetScalar(prhs[9]) : 0;
+
+  // extract relevant fields from trees (for one or multiple models)
+  const bool multi = mxIsCell(trees);
+  const int nModels = multi ? (int) mxGetNumberOfElements(trees) : 1;
+  const int nThrs = (int) mxGetNumberOfElements(prhs[6]);
+  if( nThrs!=1 && nThrs!=nModels )
+    mexErrMsgTxt("cascThr must be a scalar or have one entry per model.");
+  vector<Model> models(nModels); int maxTrees=0;
+  for( int j=0; j<nModels; j++ ) {
+    getModel(multi ? mxGetCell(trees,j) : trees, nThrs==1 ?
+      (float) mxGetScalar(prhs[6]) : (float) mxGetPr(prhs[6])[j], models[j]);
+    if(models[j].nTrees>maxTrees) maxTrees=models[j].nTrees;
+  }
+
+  // optionally collect cascade rejection statistics
+  double *rej = 0; if( nlhs>1 ) {
+    plhs[1] = mxCreateNumericMatrix(maxTrees+1,nModels,mxDOUBLE_CLASS,mxREAL);
+    rej = (double*) mxGetData(plhs[1]);
+  }
 
   // get dimensions and constants
   const mwSize *chnsSize = mxGetDimensions(prhs[0]);
   const int height = (int) chnsSize[0];
   const int width = (int) chnsSize[1];
   const int nChns = mxGetNumberOfDimensions(prhs[0])<=2 ? 1 : (int) chnsSize[2];
-  const mwSize *fidsSize = mxGetDimensions(mxGetField(trees,0,"fids"));
-  const int nTreeNodes = (int) fidsSize[0];
-  const int nTrees = (int) fidsSize[1];
   const int height1 = (int) ceil(float(height*shrink-modelHt+1)/stride);
   const int width1 = (int) ceil(float(width*shrink-modelWd+1)/stride);
 
+  // optional mask (one entry per channel pixel) marking valid window centers
+  if( hasMask && ((int) mxGetM(prhs[7])!=height ||
+    (int) mxGetN(prhs[7])!=width || mxGetElementSize(prhs[7])!=1) )
+    mexErrMsgTxt("Mask must be uint8 or logical and match chns size.");
+  const int rCen=modelHt/shrink/2, cCen=modelWd/shrink/2;
+
   // construct cids array
   int nFtrs = modelHt/shrink*modelWd/shrink*nChns;
   uint32 *cids = new uint32[nFtrs]; int m=0;
@@ -56,55 +167,38 @@ void mexFunction( int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[] )
       for( int r=0; r<modelHt/shrink; r++ )
         cids[m++] = z*width*height + c*height + r;
 
-  // apply classifier to each patch
-  vector<int> rs, cs; vector<float> hs1;
+  // bounded heaps for top detections per cell and model (if maxDets>0)
+  const int cellHt = cellSz>0 ? (height1*stride+cellSz-1)/cellSz : 1;
+  const int cellWd = cellSz>0 ? (width1*stride+cellSz-1)/cellSz : 1;
+  vector< vector<Det> > heaps(maxDets ? cellHt*cellWd*nModels : 0);
+
+  // apply classifier(s) to each patch
+  vector<Det> dets;
   for( int c=0; c<width1; c++ ) for( int r=0; r<height1; r++ ) {
-    float h=0, *chns1=chns+(r*stride/shrink) + (c*stride/shrink)*height;
-    if( treeDepth==1 ) {
-      // specialized case for treeDepth==1
-      for( int t = 0; t < nTrees; t++ ) {
-        uint32 offset=t*nTreeNodes, k=offset, k0=0;
-        getChild(chns1,cids,fids,thrs,offset,k0,k);
-        h += hs[k]; if( h<=cascThr ) break;
-      }
-    } else if( treeDepth==2 ) {
-      // specialized case for treeDepth==2
-      for( int t = 0; t < nTrees; t++ ) {
-        uint32 offset=t*nTreeNodes, k=offset, k0=0;
-        getChild(chns1,cids,fids,thrs,offset,k0,k);
-        getChild(chns1,cids,fids,thrs,offset,k0,k);
-        h += hs[k]; if( h<=cascThr ) break;
-      }
-    } else if( treeDepth>2) {
-      // specialized case for treeDepth>2
-      for( int t = 0; t < nTrees; t++ ) {
-        uint32 offset=t*nTreeNodes, k=offset, k0=0;
-        for( int i=0; i<treeDepth; i++ )
-          getChild(chns1,cids,fids,thrs,offset,k0,k);
-        h += hs[k]; if( h<=cascThr ) break;
-      }
-    } else {
-      // general case (variable tree depth)
-      for( int t = 0; t < nTrees; t++ ) {
-        uint32 offset=t*nTreeNodes, k=offset, k0=k;
-        while( child[k] ) {
-          float ftr = chns1[cids[fids[k]]];
-          k = (ftr<thrs[k]) ? 1 : 0;
-          k0 = k = child[k0]-k+offset;
-        }
-        h += hs[k]; if( h<=cascThr ) break;
-      }
+    if( hasMask && !mask[(r*stride/shrink+rCen)+(c*stride/shrink+cCen)*height] )
+      continue;
+    float *chns1=chns+(r*stride/shrink) + (c*stride/shrink)*height;
+    for( int j=0; j<nModels; j++ ) {
+      int t; float h = applyModel(models[j],chns1,cids,t);
+      if(rej) rej[(h>models[j].cascThr ? maxTrees : t)+j*(maxTrees+1)]++;
+      if(h<=models[j].cascThr) continue;
+      Det d; d.h=h; d.r=r; d.c=c; d.m=j;
+      if(!maxDets) { dets.push_back(d); continue; }
+      int cell = cellSz>0 ? r*stride/cellSz + c*stride/cellSz*cellHt : 0;
+      heapPush(heaps[cell*nModels+j],d,maxDets);
     }
-    if(h>cascThr) { cs.push_back(c); rs.push_back(r); hs1.push_back(h); }
   }
-  delete [] cids; m=cs.size();
+  delete [] cids;
+  for( size_t i=0; i<heaps.size(); i++ )
+    dets.insert(dets.end(),heaps[i].begin(),heaps[i].end());
+  m=dets.size();
 
   // convert to bbs
-  plhs[0] = mxCreateNumericMatrix(m,5,mxDOUBLE_CLASS,mxREAL);
+  plhs[0] = mxCreateNumericMatrix(m,multi?6:5,mxDOUBLE_CLASS,mxREAL);
   double *bbs = (double*) mxGetData(plhs[0]);
   for( int i=0; i<m; i++ ) {
-    bbs[i+0*m]=cs[i]*stride; bbs[i+2*m]=modelWd;
-    bbs[i+1*m]=rs[i]*stride; bbs[i+3*m]=modelHt;
-    bbs[i+4*m]=hs1[i];
+    bbs[i+0*m]=dets[i].c*stride; bbs[i+2*m]=modelWd;
+    bbs[i+1*m]=dets[i].r*stride; bbs[i+3*m]=modelHt;
+    bbs[i+4*m]=dets[i].h; if(multi) bbs[i+5*m]=dets[i].m+1;
   }
 }
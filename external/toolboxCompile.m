@@ -33,15 +33,20 @@ optsOmp=[optsOmp '-DUSEOMP'];
 % list of files (missing /private/ part of directory)
 fs={'channels/convConst.cpp', 'channels/gradientMex.cpp',...
   'channels/imPadMex.cpp', 'channels/imResampleMex.cpp',...
-  'channels/rgbConvertMex.cpp', 'classify/binaryTreeTrain1.cpp', ...
-  'classify/fernsInds1.c', 'classify/forestFindThr.cpp',...
-  'classify/forestInds.cpp', 'classify/meanShift1.c',...
-  'detector/acfDetect1.cpp', 'images/assignToBins1.c',...
-  'images/histc2c.c', 'images/imtransform2_c.c', ...
-  'images/nlfiltersep_max.c', 'images/nlfiltersep_sum.c', ...
-  'videos/ktComputeW_c.c', 'videos/ktHistcRgb_c.c', ...
-  'videos/opticalFlowHsMex.cpp' };
-n=length(fs); useOmp=zeros(1,n); if(~ismac), useOmp([6 9])=1; end
+  'channels/rgbConvertMex.cpp', 'classify/adaBoostApply1.cpp', ...
+  'classify/binaryTreeApply1.cpp', 'classify/binaryTreeTrain1.cpp', ...
+  'classify/fernsInds1.cpp', 'classify/fernsRegTrain1.cpp', ...
+  'classify/forestFindThr.cpp', 'classify/forestInds.cpp', ...
+  'classify/forestIndsPacked.cpp', 'classify/forestTrain1.cpp', ...
+  'classify/kmeans2Mex.cpp', 'classify/meanShift1.cpp', ...
+  'classify/meanShiftIm1.cpp', 'classify/pcaApply1.cpp', ...
+  'classify/pcaCov1.cpp', 'classify/pdist2Mex.cpp', ...
+  'classify/rbfComputeFtrs1.cpp', 'detector/acfDetect1.cpp', ...
+  'images/assignToBins1.c', 'images/histc2c.c', ...
+  'images/imtransform2_c.c', 'images/nlfiltersep_max.c', ...
+  'images/nlfiltersep_sum.c', 'videos/ktComputeW_c.c', ...
+  'videos/ktHistcRgb_c.c', 'videos/opticalFlowHsMex.cpp' };
+n=length(fs); useOmp=zeros(1,n); if(~ismac), useOmp(6:21)=1; end
 
 % compile every funciton in turn (special case for dijkstra)
 disp('Compiling Piotr''s Toolbox.......................');